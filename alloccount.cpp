@@ -0,0 +1,74 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloccount.h"
+
+#ifdef SNAKE_COUNT_ALLOCATIONS
+
+// Per thread, so a tick only sees the allocations of the thread running it
+static thread_local std::size_t gAllocationCount = 0;
+
+static void* countedAllocate(std::size_t size)
+{
+    gAllocationCount ++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+bool allocationCountingEnabled()
+{
+    return true;
+}
+
+std::size_t getAllocationCount()
+{
+    return gAllocationCount;
+}
+
+#else
+
+bool allocationCountingEnabled()
+{
+    return false;
+}
+
+std::size_t getAllocationCount()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <cstddef>
+
+// Optional heap allocation accounting.
+// Build with -DSNAKE_COUNT_ALLOCATIONS to replace the global operator new
+// with a counting one; otherwise the counter always reads zero.
+bool allocationCountingEnabled();
+// Allocations made so far by the calling thread
+std::size_t getAllocationCount();
+
+#endif
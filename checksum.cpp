@@ -0,0 +1,31 @@
+#include "checksum.h"
+
+static bool buildCrcTable(uint32_t* table)
+{
+    for (uint32_t i = 0; i < 256; i ++)
+    {
+        uint32_t value = i;
+        for (int j = 0; j < 8; j ++)
+        {
+            value = (value & 1) ? (0xedb88320u ^ (value >> 1)) : (value >> 1);
+        }
+        table[i] = value;
+    }
+    return true;
+}
+
+uint32_t crc32(const void* data, std::size_t size, uint32_t crc)
+{
+    // Function statics are initialized once, even with several threads
+    static uint32_t table[256];
+    static bool ready = buildCrcTable(table);
+    (void)ready;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; i ++)
+    {
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,10 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE), pass the previous result as crc to checksum in pieces
+uint32_t crc32(const void* data, std::size_t size, uint32_t crc = 0);
+
+#endif
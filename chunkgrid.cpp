@@ -0,0 +1,145 @@
+#include <cstring>
+
+#include "chunkgrid.h"
+
+ChunkGrid::ChunkGrid(): mWidth(0), mHeight(0), mPagesX(0), mChunkCount(0), mPageCount(0)
+{
+}
+
+ChunkGrid::~ChunkGrid()
+{
+    this->release();
+    for (int i = 0; i < this->mFreePages.size(); i ++)
+    {
+        delete this->mFreePages[i];
+    }
+    for (int i = 0; i < this->mFreeChunks.size(); i ++)
+    {
+        delete this->mFreeChunks[i];
+    }
+}
+
+void ChunkGrid::release()
+{
+    // Hand every page and chunk back to the free lists
+    for (int i = 0; i < this->mDirectory.size(); i ++)
+    {
+        ChunkPage* page = this->mDirectory[i];
+        if (page == nullptr)
+        {
+            continue;
+        }
+        for (int j = 0; j < kPageSize * kPageSize; j ++)
+        {
+            if (page->chunks[j] != nullptr)
+            {
+                this->mFreeChunks.push_back(page->chunks[j]);
+            }
+        }
+        this->mFreePages.push_back(page);
+        this->mDirectory[i] = nullptr;
+    }
+    this->mChunkCount = 0;
+    this->mPageCount = 0;
+}
+
+void ChunkGrid::reset(int width, int height, ChunkGenerator generator)
+{
+    this->release();
+    this->mWidth = width;
+    this->mHeight = height;
+    this->mGenerator = generator;
+    int chunksX = (width + kChunkSize - 1) >> kChunkShift;
+    int chunksY = (height + kChunkSize - 1) >> kChunkShift;
+    this->mPagesX = (chunksX + kPageSize - 1) >> kPageShift;
+    int pagesY = (chunksY + kPageSize - 1) >> kPageShift;
+    this->mDirectory.assign((std::size_t)this->mPagesX * pagesY, nullptr);
+}
+
+bool ChunkGrid::isActive() const
+{
+    return this->mWidth > 0;
+}
+
+int ChunkGrid::getWidth() const
+{
+    return this->mWidth;
+}
+
+int ChunkGrid::getHeight() const
+{
+    return this->mHeight;
+}
+
+ChunkGrid::Chunk* ChunkGrid::findChunk(int x, int y) const
+{
+    int chunkX = x >> kChunkShift;
+    int chunkY = y >> kChunkShift;
+    ChunkPage*& page = this->mDirectory[(chunkY >> kPageShift) * this->mPagesX + (chunkX >> kPageShift)];
+    if (page == nullptr)
+    {
+        if (this->mFreePages.empty())
+        {
+            page = new ChunkPage;
+        }
+        else
+        {
+            page = this->mFreePages.back();
+            this->mFreePages.pop_back();
+        }
+        std::memset(page->chunks, 0, sizeof(page->chunks));
+        this->mPageCount ++;
+    }
+    Chunk*& chunk = page->chunks[(chunkY & (kPageSize - 1)) * kPageSize + (chunkX & (kPageSize - 1))];
+    if (chunk == nullptr)
+    {
+        if (this->mFreeChunks.empty())
+        {
+            chunk = new Chunk;
+        }
+        else
+        {
+            chunk = this->mFreeChunks.back();
+            this->mFreeChunks.pop_back();
+        }
+        std::memset(chunk->cells, 0, sizeof(chunk->cells));
+        if (this->mGenerator)
+        {
+            this->mGenerator(chunkX, chunkY, chunk->cells);
+        }
+        this->mChunkCount ++;
+    }
+    return chunk;
+}
+
+unsigned char ChunkGrid::get(int x, int y) const
+{
+    if (x < 0 || x >= this->mWidth || y < 0 || y >= this->mHeight)
+    {
+        return 0;
+    }
+    Chunk* chunk = this->findChunk(x, y);
+    return chunk->cells[((y & (kChunkSize - 1)) << kChunkShift) | (x & (kChunkSize - 1))];
+}
+
+void ChunkGrid::set(int x, int y, unsigned char flags)
+{
+    if (x < 0 || x >= this->mWidth || y < 0 || y >= this->mHeight)
+    {
+        return;
+    }
+    Chunk* chunk = this->findChunk(x, y);
+    chunk->cells[((y & (kChunkSize - 1)) << kChunkShift) | (x & (kChunkSize - 1))] = flags;
+}
+
+std::size_t ChunkGrid::getChunkCount() const
+{
+    return this->mChunkCount;
+}
+
+std::size_t ChunkGrid::getMemoryUsage() const
+{
+    return this->mDirectory.capacity() * sizeof(ChunkPage*)
+        + this->mPageCount * sizeof(ChunkPage)
+        + this->mChunkCount * sizeof(Chunk);
+}
@@ -0,0 +1,68 @@
+#ifndef CHUNKGRID_H
+#define CHUNKGRID_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/*
+ * Sparse per-cell flag storage for boards far larger than the terminal.
+ * The board is cut into 64x64 chunks. A two-level directory of 32x32
+ * chunk pages finds a chunk in two indexed loads. Pages and chunks only
+ * exist once a cell inside them has been touched, and on first touch a
+ * chunk is filled by the generator, so memory follows the visited area
+ * and not the board area.
+ */
+class ChunkGrid
+{
+public:
+    static const int kChunkShift = 6;
+    static const int kChunkSize = 1 << kChunkShift;
+    static const int kPageShift = 5;
+    static const int kPageSize = 1 << kPageShift;
+
+    // Fills the cells of chunk (chunkX, chunkY), row-major, kChunkSize per row
+    typedef std::function<void(int chunkX, int chunkY, unsigned char* cells)> ChunkGenerator;
+
+    ChunkGrid();
+    ~ChunkGrid();
+    ChunkGrid(const ChunkGrid&) = delete;
+    ChunkGrid& operator = (const ChunkGrid&) = delete;
+
+    // Drops every chunk, keeping the memory for reuse by the next board
+    void reset(int width, int height, ChunkGenerator generator);
+    bool isActive() const;
+    int getWidth() const;
+    int getHeight() const;
+    // Reading a cell materializes its chunk, cells outside the board read 0
+    unsigned char get(int x, int y) const;
+    void set(int x, int y, unsigned char flags);
+    std::size_t getChunkCount() const;
+    std::size_t getMemoryUsage() const;
+
+private:
+    struct Chunk
+    {
+        unsigned char cells[kChunkSize * kChunkSize];
+    };
+    struct ChunkPage
+    {
+        Chunk* chunks[kPageSize * kPageSize];
+    };
+
+    Chunk* findChunk(int x, int y) const;
+    void release();
+
+    int mWidth;
+    int mHeight;
+    int mPagesX;
+    ChunkGenerator mGenerator;
+    // Materializing on read is invisible to callers, hence mutable
+    mutable std::vector<ChunkPage*> mDirectory;
+    mutable std::vector<ChunkPage*> mFreePages;
+    mutable std::vector<Chunk*> mFreeChunks;
+    mutable std::size_t mChunkCount;
+    mutable std::size_t mPageCount;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "controller.h"
+#include "engine.h"
+#include "checksum.h"
+
+struct GenomeHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t inputNum;
+    uint32_t hiddenNum;
+    uint32_t outputNum;
+    uint32_t weightNum;
+    uint32_t checksum;
+};
+
+static const char gGenomeMagic[8] = {'S', 'N', 'K', 'G', 'E', 'N', 'O', 'M'};
+static const uint32_t gGenomeVersion = 1;
+// How far the rays look, in cells
+static const int gRayLength = 10;
+
+// Indexed by Direction: Up, Down, Left, Right
+static const int gDirectionX[] = {0, 0, -1, 1};
+static const int gDirectionY[] = {-1, 1, 0, 0};
+static const Direction gTurnLeft[] = {Direction::Left, Direction::Right, Direction::Down, Direction::Up};
+static const Direction gTurnRight[] = {Direction::Right, Direction::Left, Direction::Up, Direction::Down};
+static const Direction gReverse[] = {Direction::Down, Direction::Up, Direction::Right, Direction::Left};
+static const int gDirectionKeys[] = {'w', 's', 'a', 'd'};
+
+// acc[i] += scale * row[i], size is a multiple of four
+static void accumulateRow(float* acc, const float* row, float scale, int size)
+{
+#if defined(__SSE__)
+    __m128 factor = _mm_set1_ps(scale);
+    for (int i = 0; i < size; i += 4)
+    {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(factor, _mm_loadu_ps(row + i)));
+        _mm_storeu_ps(acc + i, sum);
+    }
+#else
+    for (int i = 0; i < size; i ++)
+    {
+        acc[i] += scale * row[i];
+    }
+#endif
+}
+
+NeuralController::NeuralController() : mWeights(kWeightNum, 0.0f)
+{
+}
+
+std::vector<float>& NeuralController::getWeights()
+{
+    return this->mWeights;
+}
+
+const std::vector<float>& NeuralController::getWeights() const
+{
+    return this->mWeights;
+}
+
+void NeuralController::sense(Engine& engine, float* inputs)
+{
+    const BodyRing& snake = engine.getSnake().getSnake();
+    int headX = snake[0].getX();
+    int headY = snake[0].getY();
+    int heading = static_cast<int>(engine.getSnake().getDirection());
+    const int directions[] = {static_cast<int>(gTurnLeft[heading]), heading, static_cast<int>(gTurnRight[heading])};
+    for (int i = 0; i < 3; i ++)
+    {
+        int dx = gDirectionX[directions[i]];
+        int dy = gDirectionY[directions[i]];
+        int free = 0;
+        while (free < gRayLength && !engine.isDeadly(headX + dx * (free + 1), headY + dy * (free + 1)))
+        {
+            free ++;
+        }
+        inputs[i] = free == 0 ? 1.0f : 0.0f;
+        inputs[3 + i] = static_cast<float>(free) / gRayLength;
+    }
+    // The food in the snake's own frame, ahead and to the right
+    int foodX = engine.getFood().getX() - headX;
+    int foodY = engine.getFood().getY() - headY;
+    float ahead = foodX * gDirectionX[heading] + foodY * gDirectionY[heading];
+    float right = foodX * gDirectionX[directions[2]] + foodY * gDirectionY[directions[2]];
+    inputs[6] = std::max(-1.0f, std::min(1.0f, ahead / gRayLength));
+    inputs[7] = std::max(-1.0f, std::min(1.0f, right / gRayLength));
+}
+
+int NeuralController::decide(const float* inputs) const
+{
+    const float* inputWeights = this->mWeights.data();
+    const float* hiddenBiases = inputWeights + kInputNum * kHiddenNum;
+    const float* hiddenWeights = hiddenBiases + kHiddenNum;
+    const float* outputBiases = hiddenWeights + kHiddenNum * kOutputNum;
+
+    float hidden[kHiddenNum];
+    std::memcpy(hidden, hiddenBiases, sizeof(hidden));
+    for (int i = 0; i < kInputNum; i ++)
+    {
+        accumulateRow(hidden, inputWeights + i * kHiddenNum, inputs[i], kHiddenNum);
+    }
+    float outputs[kOutputNum];
+    std::memcpy(outputs, outputBiases, sizeof(outputs));
+    for (int i = 0; i < kHiddenNum; i ++)
+    {
+        accumulateRow(outputs, hiddenWeights + i * kOutputNum, std::tanh(hidden[i]), kOutputNum);
+    }
+    // The padding lane takes no part in the choice
+    int best = std::max_element(outputs, outputs + 3) - outputs;
+    return best - 1;
+}
+
+Direction NeuralController::chooseDirection(Engine& engine) const
+{
+    float inputs[kInputNum];
+    sense(engine, inputs);
+    int heading = static_cast<int>(engine.getSnake().getDirection());
+    int turn = this->decide(inputs);
+    if (turn < 0)
+    {
+        return gTurnLeft[heading];
+    }
+    if (turn > 0)
+    {
+        return gTurnRight[heading];
+    }
+    return static_cast<Direction>(heading);
+}
+
+int NeuralController::chooseKey(Engine& engine) const
+{
+    return gDirectionKeys[static_cast<int>(this->chooseDirection(engine))];
+}
+
+Direction GreedyController::chooseDirection(Engine& engine)
+{
+    Snake& snake = engine.getSnake();
+    const SnakeBody& head = snake.getSnake()[0];
+    const SnakeBody& food = engine.getFood();
+    Direction heading = snake.getDirection();
+    Direction best = heading;
+    // Deadly cells rank last, traps after any safe cell
+    int bestScore = 1 << 30;
+    for (int i = 0; i < 4; i ++)
+    {
+        Direction direction = static_cast<Direction>(i);
+        if (direction == gReverse[static_cast<int>(heading)])
+        {
+            continue;
+        }
+        int x = head.getX() + gDirectionX[i];
+        int y = head.getY() + gDirectionY[i];
+        int score = std::abs(food.getX() - x) + std::abs(food.getY() - y);
+        if (engine.isDeadly(x, y))
+        {
+            score += 1 << 28;
+        }
+        else if (engine.isTrap(x, y))
+        {
+            score += 1 << 20;
+        }
+        if (score < bestScore)
+        {
+            bestScore = score;
+            best = direction;
+        }
+    }
+    return best;
+}
+
+int GreedyController::chooseKey(Engine& engine)
+{
+    return gDirectionKeys[static_cast<int>(chooseDirection(engine))];
+}
+
+bool NeuralController::save(const std::string& path) const
+{
+    GenomeHeader header = {};
+    std::memcpy(header.magic, gGenomeMagic, sizeof(gGenomeMagic));
+    header.version = gGenomeVersion;
+    header.inputNum = kInputNum;
+    header.hiddenNum = kHiddenNum;
+    header.outputNum = kOutputNum;
+    header.weightNum = kWeightNum;
+    header.checksum = crc32(this->mWeights.data(), this->mWeights.size() * sizeof(float));
+
+    // Written aside and renamed, a checkpoint is never seen half written
+    std::string temporaryPath = path + ".tmp";
+    std::fstream fhand(temporaryPath, fhand.binary | fhand.trunc | fhand.out);
+    if (!fhand.is_open())
+    {
+        return false;
+    }
+    fhand.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fhand.write(reinterpret_cast<const char*>(this->mWeights.data()), this->mWeights.size() * sizeof(float));
+    fhand.close();
+    if (fhand.fail() || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool NeuralController::load(const std::string& path)
+{
+    std::fstream fhand(path, fhand.binary | fhand.in);
+    if (!fhand.is_open())
+    {
+        return false;
+    }
+    GenomeHeader header;
+    fhand.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!fhand || std::memcmp(header.magic, gGenomeMagic, sizeof(gGenomeMagic)) != 0
+        || header.version != gGenomeVersion || header.inputNum != kInputNum || header.hiddenNum != kHiddenNum
+        || header.outputNum != kOutputNum || header.weightNum != kWeightNum)
+    {
+        return false;
+    }
+    std::vector<float> weights(kWeightNum);
+    fhand.read(reinterpret_cast<char*>(weights.data()), weights.size() * sizeof(float));
+    if (!fhand || header.checksum != crc32(weights.data(), weights.size() * sizeof(float)))
+    {
+        return false;
+    }
+    this->mWeights.swap(weights);
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <string>
+#include <vector>
+
+#include "snake.h"
+
+class Engine;
+
+/*
+ * A small feed forward network steering the snake. It sees the board
+ * relative to the heading, so the same weights work whichever way the
+ * snake faces, and answers with a turn: left, ahead or right.
+ * The weights live in one array, laid out so both layers are computed
+ * as sums of scaled rows, four lanes at a time:
+ *   kInputNum rows of kHiddenNum, the hidden biases,
+ *   kHiddenNum rows of kOutputNum, the output biases
+ */
+class NeuralController
+{
+public:
+    static const int kInputNum = 8;
+    static const int kHiddenNum = 16;
+    // Left, ahead, right and a padding lane
+    static const int kOutputNum = 4;
+    static const int kWeightNum = kInputNum * kHiddenNum + kHiddenNum + kHiddenNum * kOutputNum + kOutputNum;
+
+    NeuralController();
+    std::vector<float>& getWeights();
+    const std::vector<float>& getWeights() const;
+    // Fills kInputNum inputs: danger left, ahead and right, free cells
+    // along those three rays, and the food ahead and to the right
+    static void sense(Engine& engine, float* inputs);
+    // -1 turn left, 0 keep going, 1 turn right
+    int decide(const float* inputs) const;
+    Direction chooseDirection(Engine& engine) const;
+    // The key the player would press for that direction
+    int chooseKey(Engine& engine) const;
+    // Genome files carry the layer sizes and a checksum of the weights
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    std::vector<float> mWeights;
+};
+
+// Heads for the food by the shortest step, off deadly cells and out of
+// regions too small for the snake when the engine tracks them
+class GreedyController
+{
+public:
+    static Direction chooseDirection(Engine& engine);
+    static int chooseKey(Engine& engine);
+};
+
+#endif
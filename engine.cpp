@@ -0,0 +1,669 @@
+#include <algorithm>
+#include <sstream>
+
+#include "engine.h"
+#include "metrics.h"
+
+// What a timer of the engine's wheel does when it fires
+enum EngineTimer
+{
+    TimerSpawnPowerUp,
+    TimerRemovePowerUp,
+    // data is the PowerUp whose effect ends
+    TimerEndEffect,
+};
+
+static_assert(kPowerUpNum <= sizeof(SnapshotHeader::effectTimers) / sizeof(int32_t), "a snapshot keeps every effect timer");
+
+Engine::Engine(int gameBoardWidth, int gameBoardHeight, const MapGenParams& params, int initialSnakeLength)
+    : mParams(params), mViewX(0), mViewY(0), mViewWidth(gameBoardWidth), mViewHeight(gameBoardHeight),
+      mPoints(0), mTickCount(0), mFreeCellRetries(0), mDead(false), mDirection(Direction::Up), mEvents(mEventCapacity),
+      mPowerUp(PowerUp::None), mSpawnTimer(0), mPowerUpTimer(0), mTrackSpace(false)
+{
+    this->mPtrMap.reset(new Map(gameBoardWidth, gameBoardHeight, this->mParams, 0));
+    this->mPtrSnake.reset(new Snake(gameBoardWidth, gameBoardHeight, initialSnakeLength));
+    this->mPtrSnake->senseMap(this->mPtrMap.get());
+    // Swapped with the map's path, so it has to hold every generated one
+    this->mPowerPathBuffer.reserve(this->mParams.powerPathNum * this->mParams.powerPathLength);
+    this->mIsBlocked = [this](int x, int y) { return this->isBlockedForObstacle(x, y); };
+    // The spawn timer, the lifetime of the item on the board and one per effect
+    this->mTimers.reserve(2 + kPowerUpNum);
+    this->setRules(this->mRules);
+}
+
+void Engine::loadLevel(const Level& level)
+{
+    this->mPtrMap->loadLevel(level);
+    this->mPtrSnake->resizeBoard(this->mPtrMap->getWidth(), this->mPtrMap->getHeight());
+    this->setView(0, 0, this->mPtrMap->getWidth(), this->mPtrMap->getHeight());
+    this->setSpaceTracking(this->mTrackSpace);
+}
+
+void Engine::initializeWorld(int width, int height, unsigned int seed)
+{
+    this->mPtrMap->initializeWorld(width, height, seed);
+    this->mPtrSnake->resizeBoard(this->mPtrMap->getWidth(), this->mPtrMap->getHeight());
+    this->setView(0, 0, this->mPtrMap->getWidth(), this->mPtrMap->getHeight());
+    this->setSpaceTracking(false);
+}
+
+void Engine::setSpaceTracking(bool enabled)
+{
+    // Labelling a world would materialize every chunk of it
+    this->mTrackSpace = enabled && !this->mPtrMap->isWorld();
+    if (this->mTrackSpace)
+    {
+        this->mReachability.rebuild(*this->mPtrMap, this->mPtrSnake->getSnake());
+    }
+    else
+    {
+        this->mReachability.clear();
+    }
+}
+
+const Reachability& Engine::getReachability() const
+{
+    return this->mReachability;
+}
+
+bool Engine::isTrap(int x, int y)
+{
+    return this->mTrackSpace && this->mReachability.getRegionSize(x, y) < this->mPtrSnake->getLength();
+}
+
+void Engine::resizeBoard(int gameBoardWidth, int gameBoardHeight)
+{
+    if (this->mPtrMap->hasFixedBounds())
+    {
+        return;
+    }
+    // The snake and the map keep their state
+    this->mPtrSnake->resizeBoard(gameBoardWidth, gameBoardHeight);
+    this->mPtrMap->resizeBoard(gameBoardWidth, gameBoardHeight);
+    this->setView(0, 0, gameBoardWidth, gameBoardHeight);
+    if (this->mTrackSpace)
+    {
+        this->mReachability.rebuild(*this->mPtrMap, this->mPtrSnake->getSnake());
+    }
+    if (this->mFood.getX() >= gameBoardWidth - 1 || this->mFood.getY() >= gameBoardHeight - 1)
+    {
+        this->createRandomFood();
+    }
+}
+
+void Engine::initializeRound(unsigned int seed)
+{
+    this->mRandom.seed(seed);
+    // Levels and worlds keep their seed, generated boards get a new one
+    if (!this->mPtrMap->hasFixedBounds())
+    {
+        this->mPtrMap->setSeed(seed);
+    }
+    this->mPtrMap->initializeMap();
+    int spawnNum = this->mPtrMap->getSpawnPointNum();
+    SnakeBody spawn = this->mPtrMap->getSpawnPoint(spawnNum > 0 ? this->mRandom() % spawnNum : 0);
+    this->mPtrSnake->setSpawnPoint(spawn.getX(), spawn.getY());
+    this->mPtrSnake->initializeSnake();
+    this->mFood = SnakeBody();
+    this->mSnakeAhead = SnakeBody();
+    this->mPoints = 0;
+    this->mTickCount = 0;
+    this->mDead = false;
+    this->mDirection = this->mPtrSnake->getDirection();
+    this->mTimers.reset(0);
+    this->mPowerUp = PowerUp::None;
+    this->mSpawnTimer = 0;
+    this->mPowerUpTimer = 0;
+    std::fill(this->mEffectTimers, this->mEffectTimers + kPowerUpNum, 0);
+    if (this->mRules.powerUpInterval > 0)
+    {
+        this->mSpawnTimer = this->mTimers.schedule(this->mRules.powerUpInterval, TimerSpawnPowerUp, 0);
+    }
+    const SnakeBody& head = this->mPtrSnake->getSnake()[0];
+    this->mEvents.publish(EngineEventType::RoundStarted, int(seed), head.getX(), head.getY(), 0);
+    if (this->mTrackSpace)
+    {
+        this->mReachability.rebuild(*this->mPtrMap, this->mPtrSnake->getSnake());
+    }
+}
+
+void Engine::setRules(const RuleParams& rules)
+{
+    this->mRules = rules;
+    this->mRules.growth = std::max(1, std::min(kMaxGrowth, rules.growth));
+    this->mStepFunction = Snake::selectStep(this->mRules);
+}
+
+const RuleParams& Engine::getRules() const
+{
+    return this->mRules;
+}
+
+void Engine::setView(int x, int y, int width, int height)
+{
+    this->mViewX = x;
+    this->mViewY = y;
+    this->mViewWidth = width;
+    this->mViewHeight = height;
+}
+
+void Engine::spawnItems()
+{
+    this->createRandomFood();
+    // Worlds start without one, levels bring their own
+    if (this->mPtrMap->getPowerPathLength() == 0 && !this->mPtrMap->hasLevel())
+    {
+        this->createRandomPowerPath();
+    }
+}
+
+const SnakeStep& Engine::step(int key)
+{
+    Direction direction = this->mPtrSnake->getDirection();
+    if (direction != this->mDirection)
+    {
+        const SnakeBody& head = this->mPtrSnake->getSnake()[0];
+        this->mEvents.publish(EngineEventType::DirectionChanged, int(direction), head.getX(), head.getY(), this->mTickCount);
+        this->mDirection = direction;
+    }
+    this->mLastStep = (this->mPtrSnake.get()->*this->mStepFunction)(key);
+    const SnakeStep& step = this->mLastStep;
+    if (Snake::isDeath(step.result))
+    {
+        this->mDead = true;
+        this->mEvents.publish(EngineEventType::Death, int(step.result), step.head.getX(), step.head.getY(), this->mTickCount);
+        return step;
+    }
+    if (step.result == StepResult::ObstacleSurvived)
+    {
+        this->mEvents.publish(EngineEventType::ObstacleSurvived, 0, step.head.getX(), step.head.getY(), this->mTickCount);
+    }
+    if (this->mPowerUp != PowerUp::None && step.head == this->mPowerUpCell)
+    {
+        this->takePowerUp();
+    }
+    if (this->mTrackSpace)
+    {
+        // Freed before the head is placed, the head may take the old tail's cell
+        for (int i = 0; i < step.freedNum; i ++)
+        {
+            if (!this->mPtrMap->isObstacle(step.freed[i].getX(), step.freed[i].getY()))
+            {
+                this->mReachability.freeCell(step.freed[i].getX(), step.freed[i].getY());
+            }
+        }
+        // A ghost's head can be inside an obstacle, which is blocked already
+        if (!this->mPtrMap->isObstacle(step.head.getX(), step.head.getY()))
+        {
+            this->mReachability.blockCell(step.head.getX(), step.head.getY());
+        }
+    }
+    if (step.result == StepResult::Ate)
+    {
+        this->createRandomFood();
+        if (this->mDead)
+        {
+            return step;
+        }
+        int before = this->mPoints;
+        this->mPoints += this->isEffectActive(PowerUp::Multiplier) ? 2 : 1;
+        this->mEvents.publish(EngineEventType::FoodEaten, this->mPoints, step.head.getX(), step.head.getY(), this->mTickCount);
+        // Every difficulty step moves the power path somewhere else
+        if (this->mPoints / 5 != before / 5)
+        {
+            this->mEvents.publish(EngineEventType::DifficultyChanged, this->mPoints / 5, step.head.getX(), step.head.getY(), this->mTickCount);
+            this->createRandomPowerPath();
+            this->mEvents.publish(EngineEventType::PowerPathMoved, 0, step.head.getX(), step.head.getY(), this->mTickCount);
+        }
+    }
+    const std::vector<TimerExpiry>& expired = this->mTimers.advance();
+    for (int i = 0; i < expired.size(); i ++)
+    {
+        this->fireTimer(expired[i]);
+    }
+    this->mSnakeAhead = step.ahead;
+    this->mPtrMap->moveObstacles(this->mTickCount, this->mIsBlocked);
+    if (this->mTrackSpace)
+    {
+        const std::vector<SnakeBody>& movedFrom = this->mPtrMap->getMovedFrom();
+        const std::vector<SnakeBody>& movedTo = this->mPtrMap->getMovedTo();
+        for (int i = 0; i < movedFrom.size(); i ++)
+        {
+            // The snake can have stepped onto a mover that walked off since
+            int x = movedFrom[i].getX();
+            int y = movedFrom[i].getY();
+            if (!(this->mPtrMap->getCell(x, y) & CellSnake))
+            {
+                this->mReachability.freeCell(x, y);
+            }
+            this->mReachability.blockCell(movedTo[i].getX(), movedTo[i].getY());
+        }
+    }
+    this->mTickCount ++;
+    return step;
+}
+
+bool Engine::isDead() const
+{
+    return this->mDead;
+}
+
+EventBus& Engine::getEvents()
+{
+    return this->mEvents;
+}
+
+bool Engine::isDeadly(int x, int y)
+{
+    return this->mPtrMap->getCell(x, y) & (CellWall | CellObstacle | CellSnake);
+}
+
+bool Engine::findFreeCell(SnakeBody& cell)
+{
+    // Items land inside the view, keeping clear of the walls at x <= 1
+    // and x >= width - 1
+    int minX = std::max(2, this->mViewX + 1);
+    int maxX = std::min(this->mPtrMap->getWidth() - 2, this->mViewX + this->mViewWidth - 2);
+    int minY = std::max(1, this->mViewY + 1);
+    int maxY = std::min(this->mPtrMap->getHeight() - 2, this->mViewY + this->mViewHeight - 2);
+    this->mFreeCellRetries = 0;
+    if (minX > maxX || minY > maxY)
+    {
+        return false;
+    }
+    for (int i = 0; i < kFreeCellTries; i ++)
+    {
+        int x = this->mRandom() % (maxX - minX + 1) + minX;
+        int y = this->mRandom() % (maxY - minY + 1) + minY;
+        if (this->isFreeCell(x, y))
+        {
+            cell = SnakeBody(x, y);
+            return true;
+        }
+        this->mFreeCellRetries ++;
+    }
+    // A crowded view, walk it once from a random cell
+    int width = maxX - minX + 1;
+    int area = width * (maxY - minY + 1);
+    int start = this->mRandom() % area;
+    for (int i = 0; i < area; i ++)
+    {
+        int index = (start + i) % area;
+        int x = minX + index % width;
+        int y = minY + index / width;
+        if (this->isFreeCell(x, y))
+        {
+            cell = SnakeBody(x, y);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Engine::isFreeCell(int x, int y) const
+{
+    SnakeBody cell(x, y);
+    return !(this->mPtrMap->getCell(x, y) & (CellSnake | CellObstacle)) && cell != this->mFood
+        && (this->mPowerUp == PowerUp::None || cell != this->mPowerUpCell);
+}
+
+void Engine::createRandomFood()
+{
+    SnakeBody food;
+    if (!this->findFreeCell(food))
+    {
+        // The snake filled the view, nothing is left to eat
+        this->mDead = true;
+        const SnakeBody& head = this->mPtrSnake->getSnake()[0];
+        this->mEvents.publish(EngineEventType::BoardFilled, this->mPoints, head.getX(), head.getY(), this->mTickCount);
+        return;
+    }
+    this->mFood = food;
+    this->mPtrSnake->senseFood(this->mFood);
+    countMetric(MetricFoodSpawnRetries, this->mFreeCellRetries);
+}
+
+void Engine::createRandomPowerUp()
+{
+    if (!this->findFreeCell(this->mPowerUpCell))
+    {
+        // Tried again after another interval
+        this->mSpawnTimer = this->mTimers.schedule(this->mRules.powerUpInterval, TimerSpawnPowerUp, 0);
+        return;
+    }
+    this->mPowerUp = PowerUp(this->mRandom() % (kPowerUpNum - 1) + 1);
+    this->mPowerUpTimer = this->mTimers.schedule(this->mRules.powerUpLifetime, TimerRemovePowerUp, 0);
+    this->mEvents.publish(EngineEventType::PowerUpSpawned, int(this->mPowerUp), this->mPowerUpCell.getX(), this->mPowerUpCell.getY(), this->mTickCount);
+}
+
+void Engine::takePowerUp()
+{
+    PowerUp powerUp = this->mPowerUp;
+    this->mPowerUp = PowerUp::None;
+    this->mTimers.cancel(this->mPowerUpTimer);
+    this->mSpawnTimer = this->mTimers.schedule(this->mRules.powerUpInterval, TimerSpawnPowerUp, 0);
+    this->mEvents.publish(EngineEventType::PowerUpTaken, int(powerUp), this->mPowerUpCell.getX(), this->mPowerUpCell.getY(), this->mTickCount);
+    if (powerUp == PowerUp::Shrink)
+    {
+        // The cells go out with the step's freed tail
+        this->mPtrSnake->shrink(2, this->mLastStep);
+        return;
+    }
+    // Taking the same power-up again restarts its effect
+    int index = int(powerUp);
+    this->mTimers.cancel(this->mEffectTimers[index]);
+    this->mEffectTimers[index] = this->mTimers.schedule(this->mRules.effectDuration, TimerEndEffect, index);
+    if (powerUp == PowerUp::Ghost)
+    {
+        this->mPtrSnake->setGhost(true);
+    }
+}
+
+void Engine::fireTimer(const TimerExpiry& expiry)
+{
+    const SnakeBody& head = this->mPtrSnake->getSnake()[0];
+    switch (expiry.kind)
+    {
+        case TimerSpawnPowerUp:
+            this->createRandomPowerUp();
+            break;
+        case TimerRemovePowerUp:
+            this->mEvents.publish(EngineEventType::PowerUpRemoved, int(this->mPowerUp), this->mPowerUpCell.getX(), this->mPowerUpCell.getY(), this->mTickCount);
+            this->mPowerUp = PowerUp::None;
+            this->mSpawnTimer = this->mTimers.schedule(this->mRules.powerUpInterval, TimerSpawnPowerUp, 0);
+            break;
+        case TimerEndEffect:
+            this->mEffectTimers[expiry.data] = 0;
+            if (PowerUp(expiry.data) == PowerUp::Ghost)
+            {
+                this->mPtrSnake->setGhost(false);
+            }
+            this->mEvents.publish(EngineEventType::EffectEnded, expiry.data, head.getX(), head.getY(), this->mTickCount);
+            break;
+    }
+}
+
+void Engine::createRandomPowerPath()
+{
+    // As many random walks of powerPathLength cells as the board was
+    // generated with, inside the view and over cells that are neither
+    // obstacles, snake nor food
+    int minX = std::max(2, this->mViewX + 1);
+    int maxX = std::min(this->mPtrMap->getWidth() - 2, this->mViewX + this->mViewWidth - 2);
+    int minY = std::max(1, this->mViewY + 1);
+    int maxY = std::min(this->mPtrMap->getHeight() - 2, this->mViewY + this->mViewHeight - 2);
+    if (maxX < minX || maxY < minY)
+    {
+        return;
+    }
+    std::vector<SnakeBody>& path = this->mPowerPathBuffer;
+    path.clear();
+    const int dx[] = {0, 0, -1, 1};
+    const int dy[] = {-1, 1, 0, 0};
+    for (int i = 0; i < this->mParams.powerPathNum; i ++)
+    {
+        int x = this->mRandom() % (maxX - minX + 1) + minX;
+        int y = this->mRandom() % (maxY - minY + 1) + minY;
+        std::size_t walkStart = path.size();
+        for (int j = 0; j < this->mParams.powerPathLength; j ++)
+        {
+            SnakeBody cell(x, y);
+            bool blocked = (this->mPtrMap->getCell(x, y) & (CellSnake | CellObstacle)) || cell == this->mFood;
+            if (!blocked && std::find(path.begin(), path.end(), cell) == path.end())
+            {
+                path.push_back(cell);
+            }
+            int direction = this->mRandom() % 4;
+            int nextX = std::max(minX, std::min(maxX, x + dx[direction]));
+            int nextY = std::max(minY, std::min(maxY, y + dy[direction]));
+            if (!this->mPtrMap->isObstacle(nextX, nextY) || path.size() == walkStart)
+            {
+                x = nextX;
+                y = nextY;
+            }
+        }
+    }
+    // Hands back the storage of the previous path for the next call
+    this->mPtrMap->setPowerPath(std::move(path));
+}
+
+bool Engine::isBlockedForObstacle(int x, int y) const
+{
+    // Movers keep off the snake, the food, the power-up and the cell the
+    // head enters next
+    SnakeBody cell(x, y);
+    return cell == this->mFood || cell == this->mSnakeAhead || (this->mPtrMap->getCell(x, y) & CellSnake)
+        || (this->mPowerUp != PowerUp::None && cell == this->mPowerUpCell);
+}
+
+Snake& Engine::getSnake()
+{
+    return *this->mPtrSnake;
+}
+
+Map& Engine::getMap()
+{
+    return *this->mPtrMap;
+}
+
+const SnakeBody& Engine::getFood() const
+{
+    return this->mFood;
+}
+
+PowerUp Engine::getPowerUp() const
+{
+    return this->mPowerUp;
+}
+
+const SnakeBody& Engine::getPowerUpCell() const
+{
+    return this->mPowerUpCell;
+}
+
+bool Engine::isEffectActive(PowerUp powerUp) const
+{
+    return this->mEffectTimers[int(powerUp)] != 0;
+}
+
+double Engine::getSpeedScale() const
+{
+    return this->isEffectActive(PowerUp::Speed) ? this->mSpeedBoost : 1.0;
+}
+
+int Engine::getPoints() const
+{
+    return this->mPoints;
+}
+
+long long Engine::getTickCount() const
+{
+    return this->mTickCount;
+}
+
+SnapshotHeader& Engine::saveSnapshot(std::vector<unsigned char>& buffer)
+{
+    const Map& map = *this->mPtrMap;
+    const BodyRing& body = this->mPtrSnake->getSnake();
+    const std::vector<SnakeBody>& powerPath = map.getPowerPath();
+    const std::vector<MovingObstacle>& movers = map.getMovers();
+    const uint64_t* obstacleBits = map.getObstacleBits();
+    uint64_t obstacleWords = obstacleBits == nullptr ? 0 : ((uint64_t)map.getWidth() * map.getHeight() + 63) / 64;
+    SnapshotFile::layout(buffer, body.size(), powerPath.size(), movers.size(), obstacleWords);
+    unsigned char* data = buffer.data();
+    SnapshotHeader& header = *reinterpret_cast<SnapshotHeader*>(data);
+
+    header.board = map.hasLevel() ? SnapshotBoard::Level : (map.isWorld() ? SnapshotBoard::World : SnapshotBoard::Generated);
+    header.width = map.getWidth();
+    header.height = map.getHeight();
+    header.seed = map.getSeed();
+    header.levelIndex = -1;
+    header.walls = uint32_t(this->mRules.walls);
+    header.obstacles = uint32_t(this->mRules.obstacles);
+    header.growth = this->mRules.growth;
+    header.speed = uint32_t(this->mRules.speed);
+    header.powerUpInterval = this->mRules.powerUpInterval;
+    header.powerUpLifetime = this->mRules.powerUpLifetime;
+    header.effectDuration = this->mRules.effectDuration;
+    header.direction = uint32_t(this->mPtrSnake->getDirection());
+    header.lastDirection = uint32_t(this->mDirection);
+    header.pendingGrowth = this->mPtrSnake->getPendingGrowth();
+    header.ghost = this->mPtrSnake->isGhost();
+    header.food = this->mFood.getPacked();
+    header.snakeAhead = this->mSnakeAhead.getPacked();
+    header.powerUp = uint32_t(this->mPowerUp);
+    header.powerUpCell = this->mPowerUpCell.getPacked();
+    header.points = this->mPoints;
+    header.tickCount = this->mTickCount;
+    // Timers are kept as the ticks they have left, the wheel starts over on load
+    long long deadline = this->mTimers.getDeadline(this->mSpawnTimer);
+    header.spawnTimer = deadline < 0 ? 0 : deadline - this->mTimers.getTick();
+    deadline = this->mTimers.getDeadline(this->mPowerUpTimer);
+    header.powerUpTimer = deadline < 0 ? 0 : deadline - this->mTimers.getTick();
+    for (int i = 0; i < kPowerUpNum; i ++)
+    {
+        deadline = this->mTimers.getDeadline(this->mEffectTimers[i]);
+        header.effectTimers[i] = deadline < 0 ? 0 : deadline - this->mTimers.getTick();
+    }
+
+    std::stringstream state;
+    state << this->mRandom;
+    uint32_t* random = reinterpret_cast<uint32_t*>(data + header.randomOffset);
+    for (int i = 0; i < SnapshotFile::kRandomWords && state >> random[i]; i ++)
+    {
+    }
+    uint64_t* bodyCells = reinterpret_cast<uint64_t*>(data + header.bodyOffset);
+    for (int i = 0; i < body.size(); i ++)
+    {
+        bodyCells[i] = body[i].getPacked();
+    }
+    uint64_t* powerPathCells = reinterpret_cast<uint64_t*>(data + header.powerPathOffset);
+    for (int i = 0; i < powerPath.size(); i ++)
+    {
+        powerPathCells[i] = powerPath[i].getPacked();
+    }
+    SnapshotMover* savedMovers = reinterpret_cast<SnapshotMover*>(data + header.moverOffset);
+    for (int i = 0; i < movers.size(); i ++)
+    {
+        SnapshotMover mover = {movers[i].x, movers[i].y, movers[i].direction, movers[i].step, movers[i].length, movers[i].loop};
+        savedMovers[i] = mover;
+    }
+    if (obstacleWords > 0)
+    {
+        std::copy(obstacleBits, obstacleBits + obstacleWords, reinterpret_cast<uint64_t*>(data + header.obstacleOffset));
+    }
+    return header;
+}
+
+bool Engine::loadSnapshot(const SnapshotFile& snapshot)
+{
+    const SnapshotHeader& header = snapshot.getHeader();
+    int width = header.width;
+    int height = header.height;
+    bool sameBoard = header.board == SnapshotBoard::Level ? this->mPtrMap->hasLevel()
+        : (header.board == SnapshotBoard::World ? this->mPtrMap->isWorld() : !this->mPtrMap->hasFixedBounds());
+    if (!sameBoard || header.width < 3 || header.height < 3
+        || header.width > INT32_MAX || header.height > INT32_MAX
+        || header.bodyLength == 0 || header.direction > uint32_t(Direction::Right)
+        || header.lastDirection > uint32_t(Direction::Right) || header.powerUp >= kPowerUpNum
+        || (header.board == SnapshotBoard::Generated && header.obstacleWords != ((uint64_t)width * height + 63) / 64))
+    {
+        return false;
+    }
+    // Every cell must lie on the board before anything is adopted
+    auto isInside = [width, height](uint64_t packed)
+    {
+        SnakeBody cell = SnakeBody::fromPacked(packed);
+        return cell.getX() >= 0 && cell.getX() < width && cell.getY() >= 0 && cell.getY() < height;
+    };
+    const uint64_t* bodyCells = snapshot.getBody();
+    for (int i = 0; i < header.bodyLength; i ++)
+    {
+        if (!isInside(bodyCells[i]))
+        {
+            return false;
+        }
+    }
+    const uint64_t* powerPathCells = snapshot.getPowerPath();
+    for (int i = 0; i < header.powerPathLength; i ++)
+    {
+        if (!isInside(powerPathCells[i]))
+        {
+            return false;
+        }
+    }
+    if (!isInside(header.food) || (PowerUp(header.powerUp) != PowerUp::None && !isInside(header.powerUpCell)))
+    {
+        return false;
+    }
+    std::vector<MovingObstacle> movers(header.moverNum);
+    const SnapshotMover* savedMovers = snapshot.getMovers();
+    for (int i = 0; i < movers.size(); i ++)
+    {
+        const SnapshotMover& saved = savedMovers[i];
+        if (saved.x < 0 || saved.x >= width || saved.y < 0 || saved.y >= height || saved.direction < 0
+            || saved.direction > 3 || saved.length < 1 || saved.step < 0 || saved.step > saved.length)
+        {
+            return false;
+        }
+        MovingObstacle mover = {savedMovers[i].x, savedMovers[i].y, savedMovers[i].direction,
+            savedMovers[i].step, savedMovers[i].length, savedMovers[i].loop != 0};
+        movers[i] = mover;
+    }
+    const uint64_t* obstacleBits = header.board == SnapshotBoard::Generated ? snapshot.getObstacleBits() : nullptr;
+    if (!this->mPtrMap->restoreBoard(width, height, header.seed, obstacleBits, movers))
+    {
+        return false;
+    }
+    this->mPtrSnake->resizeBoard(this->mPtrMap->getWidth(), this->mPtrMap->getHeight());
+    this->setView(0, 0, this->mPtrMap->getWidth(), this->mPtrMap->getHeight());
+
+    RuleParams rules;
+    rules.walls = WallRule(header.walls);
+    rules.obstacles = ObstacleRule(header.obstacles);
+    rules.growth = header.growth;
+    rules.speed = SpeedRule(header.speed);
+    rules.powerUpInterval = header.powerUpInterval;
+    rules.powerUpLifetime = header.powerUpLifetime;
+    rules.effectDuration = header.effectDuration;
+    this->setRules(rules);
+
+    std::stringstream state;
+    const uint32_t* random = snapshot.getRandomState();
+    for (int i = 0; i < SnapshotFile::kRandomWords; i ++)
+    {
+        state << random[i] << ' ';
+    }
+    state >> this->mRandom;
+
+    this->mPtrSnake->restore(bodyCells, header.bodyLength, Direction(header.direction), header.pendingGrowth, header.ghost != 0);
+    this->mFood = SnakeBody::fromPacked(header.food);
+    this->mPtrSnake->senseFood(this->mFood);
+    this->mSnakeAhead = SnakeBody::fromPacked(header.snakeAhead);
+    this->mPowerUp = PowerUp(header.powerUp);
+    this->mPowerUpCell = SnakeBody::fromPacked(header.powerUpCell);
+    this->mPoints = header.points;
+    this->mTickCount = header.tickCount;
+    this->mDead = false;
+    this->mDirection = Direction(header.lastDirection);
+
+    this->mTimers.reset(this->mTickCount);
+    this->mSpawnTimer = header.spawnTimer > 0 ? this->mTimers.schedule(header.spawnTimer, TimerSpawnPowerUp, 0) : 0;
+    this->mPowerUpTimer = header.powerUpTimer > 0 ? this->mTimers.schedule(header.powerUpTimer, TimerRemovePowerUp, 0) : 0;
+    for (int i = 0; i < kPowerUpNum; i ++)
+    {
+        this->mEffectTimers[i] = header.effectTimers[i] > 0 ? this->mTimers.schedule(header.effectTimers[i], TimerEndEffect, i) : 0;
+    }
+
+    this->mPowerPathBuffer.clear();
+    for (int i = 0; i < header.powerPathLength; i ++)
+    {
+        this->mPowerPathBuffer.push_back(SnakeBody::fromPacked(powerPathCells[i]));
+    }
+    this->mPtrMap->setPowerPath(std::move(this->mPowerPathBuffer));
+    if (this->mTrackSpace)
+    {
+        this->mReachability.rebuild(*this->mPtrMap, this->mPtrSnake->getSnake());
+    }
+    return true;
+}
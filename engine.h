@@ -0,0 +1,145 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "snake.h"
+#include "map.h"
+#include "level.h"
+#include "reachability.h"
+#include "rules.h"
+#include "eventbus.h"
+#include "timerwheel.h"
+#include "snapshot.h"
+
+// Food with a timed effect, one on the board at a time
+enum class PowerUp
+{
+    None,
+    // The snake runs faster
+    Speed,
+    // Takes two segments off the tail at once
+    Shrink,
+    // Obstacles are passed through
+    Ghost,
+    // Food counts twice
+    Multiplier,
+};
+
+const int kPowerUpNum = 5;
+
+// The rules of a round without any curses: the snake, the map, the food
+// and the power paths. Everything random in a round comes from the seed
+// it was started with, so a headless copy replays the same board the
+// same way. The Game renders an Engine, the trainer runs many of them.
+class Engine
+{
+public:
+    Engine(int gameBoardWidth, int gameBoardHeight, const MapGenParams& params, int initialSnakeLength);
+    // Board setup, before the first round
+    void loadLevel(const Level& level);
+    void initializeWorld(int width, int height, unsigned int seed);
+    // Adopt new board bounds after a terminal resize, fixed boards ignore it
+    void resizeBoard(int gameBoardWidth, int gameBoardHeight);
+    // Walls, obstacles and growth, the speed rule is up to whoever paces the ticks
+    void setRules(const RuleParams& rules);
+    const RuleParams& getRules() const;
+    // Lays out the board and the snake of a new round
+    void initializeRound(unsigned int seed);
+    // Food and power paths land inside this rectangle, the whole map by default
+    void setView(int x, int y, int width, int height);
+    // Places the first food and power path, once the view follows the new snake
+    void spawnItems();
+    // One tick after the direction change, what the snake ran into and
+    // which cells it left
+    const SnakeStep& step(int key);
+    bool isDead() const;
+    // What happened in the round, for anyone who subscribes. Published
+    // from the thread that steps the engine.
+    EventBus& getEvents();
+    // True for cells the head dies in: walls, obstacles and the body
+    bool isDeadly(int x, int y);
+    // Keep the free regions of the board labelled as the snake moves,
+    // not available on sparse worlds
+    void setSpaceTracking(bool enabled);
+    const Reachability& getReachability() const;
+    // Entering a cell whose region is smaller than the snake traps it
+    bool isTrap(int x, int y);
+
+    void createRandomFood();
+    void createRandomPowerPath();
+    void createRandomPowerUp();
+    bool isBlockedForObstacle(int x, int y) const;
+
+    Snake& getSnake();
+    Map& getMap();
+    const SnakeBody& getFood() const;
+    // PowerUp::None while there is none on the board
+    PowerUp getPowerUp() const;
+    const SnakeBody& getPowerUpCell() const;
+    bool isEffectActive(PowerUp powerUp) const;
+    // Tick rate factor of the active effects
+    double getSpeedScale() const;
+    int getPoints() const;
+    long long getTickCount() const;
+    // Lays the round out in buffer, flat as it goes to disk. The caller
+    // adds its pacing and the level it loaded to the header before
+    // SnapshotFile::write.
+    SnapshotHeader& saveSnapshot(std::vector<unsigned char>& buffer);
+    // Resumes the saved round, false when it was played on another kind
+    // of board or on a level of another size. The caller matches the
+    // level itself.
+    bool loadSnapshot(const SnapshotFile& snapshot);
+
+private:
+    // A free cell inside the view, off the snake, the obstacles and the food,
+    // false when the view has none left
+    bool findFreeCell(SnakeBody& cell);
+    bool isFreeCell(int x, int y) const;
+    void takePowerUp();
+    void fireTimer(const TimerExpiry& expiry);
+
+    std::unique_ptr<Map> mPtrMap;
+    std::unique_ptr<Snake> mPtrSnake;
+    MapGenParams mParams;
+    std::mt19937 mRandom;
+    SnakeBody mFood;
+    SnakeBody mSnakeAhead;
+    SnakeStep mLastStep;
+    RuleParams mRules;
+    // Snake::step specialized for mRules
+    Snake::StepFunction mStepFunction;
+    std::vector<SnakeBody> mPowerPathBuffer;
+    // Built once, capturing only this keeps it free of allocations
+    std::function<bool(int, int)> mIsBlocked;
+    int mViewX;
+    int mViewY;
+    int mViewWidth;
+    int mViewHeight;
+    int mPoints;
+    long long mTickCount;
+    // Random draws before findFreeCell walks the view
+    static const int kFreeCellTries = 64;
+    // Taken cells drawn by the last findFreeCell
+    int mFreeCellRetries;
+    bool mDead;
+    // To tell a direction change apart at the next step
+    Direction mDirection;
+    static const int mEventCapacity = 1024;
+    EventBus mEvents;
+    // Power-up spawns and expirations and the end of every effect
+    TimerWheel mTimers;
+    PowerUp mPowerUp;
+    SnakeBody mPowerUpCell;
+    uint32_t mSpawnTimer;
+    uint32_t mPowerUpTimer;
+    uint32_t mEffectTimers[kPowerUpNum];
+    const double mSpeedBoost = 1.5;
+    Reachability mReachability;
+    bool mTrackSpace;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "eventbus.h"
+
+EventBus::EventBus(int capacity): mHead(0)
+{
+    uint64_t size = 1;
+    while (size < (uint64_t)capacity)
+    {
+        size *= 2;
+    }
+    this->mSlots.reset(new Slot[size]);
+    this->mMask = size - 1;
+}
+
+void EventBus::publish(EngineEventType type, int value, int x, int y, long long tick)
+{
+    uint64_t position = this->mHead.load(std::memory_order_relaxed);
+    Slot& slot = this->mSlots[position & this->mMask];
+    slot.sequence.store(position * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.words[0].store(uint64_t(type) | (uint64_t(uint32_t(value)) << 32), std::memory_order_relaxed);
+    slot.words[1].store(uint64_t(uint32_t(x)) | (uint64_t(uint32_t(y)) << 32), std::memory_order_relaxed);
+    slot.words[2].store(uint64_t(tick), std::memory_order_relaxed);
+    slot.sequence.store(position * 2 + 2, std::memory_order_release);
+    this->mHead.store(position + 1, std::memory_order_release);
+}
+
+EventSubscriber EventBus::subscribe() const
+{
+    return EventSubscriber(this, this->mHead.load(std::memory_order_acquire));
+}
+
+EventSubscriber::EventSubscriber(): mBus(nullptr), mCursor(0), mDropped(0)
+{
+}
+
+EventSubscriber::EventSubscriber(const EventBus* bus, uint64_t cursor): mBus(bus), mCursor(cursor), mDropped(0)
+{
+}
+
+bool EventSubscriber::poll(EngineEvent& event)
+{
+    if (this->mBus == nullptr)
+    {
+        return false;
+    }
+    while (true)
+    {
+        const EventBus::Slot& slot = this->mBus->mSlots[this->mCursor & this->mBus->mMask];
+        uint64_t expected = this->mCursor * 2 + 2;
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        // Not published yet, or still being written
+        if (before < expected)
+        {
+            return false;
+        }
+        if (before == expected)
+        {
+            uint64_t word0 = slot.words[0].load(std::memory_order_relaxed);
+            uint64_t word1 = slot.words[1].load(std::memory_order_relaxed);
+            uint64_t word2 = slot.words[2].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == expected)
+            {
+                event.type = EngineEventType(uint32_t(word0));
+                event.value = int32_t(word0 >> 32);
+                event.x = int32_t(uint32_t(word1));
+                event.y = int32_t(word1 >> 32);
+                event.tick = int64_t(word2);
+                this->mCursor ++;
+                return true;
+            }
+        }
+        // Lapped by the producer, skip to the oldest event still in the ring
+        uint64_t head = this->mBus->mHead.load(std::memory_order_acquire);
+        uint64_t oldest = head > this->mBus->mMask + 1 ? head - (this->mBus->mMask + 1) : 0;
+        if (oldest > this->mCursor)
+        {
+            this->mDropped += oldest - this->mCursor;
+            this->mCursor = oldest;
+        }
+        else
+        {
+            // The slot moved on but the head store is not visible yet
+            this->mDropped ++;
+            this->mCursor ++;
+        }
+    }
+}
+
+uint64_t EventSubscriber::getDropped() const
+{
+    return this->mDropped;
+}
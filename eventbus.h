@@ -0,0 +1,98 @@
+#ifndef EVENTBUS_H
+#define EVENTBUS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+enum class EngineEventType : uint32_t
+{
+    // value is the seed of the round
+    RoundStarted,
+    // value is the points after eating
+    FoodEaten,
+    // value is the new Direction
+    DirectionChanged,
+    ObstacleSurvived,
+    // value is the fatal StepResult
+    Death,
+    // value is the new difficulty
+    DifficultyChanged,
+    PowerPathMoved,
+    // value is the PowerUp, x and y its cell
+    PowerUpSpawned,
+    PowerUpTaken,
+    // Left on the board until its lifetime ran out
+    PowerUpRemoved,
+    // value is the PowerUp whose effect wore off
+    EffectEnded,
+    // No free cell was left for the food, the round is over; value is
+    // the points
+    BoardFilled,
+};
+
+struct EngineEvent
+{
+    EngineEventType type;
+    int32_t value;
+    // The head when the event happened
+    int32_t x;
+    int32_t y;
+    int64_t tick;
+};
+
+class EventSubscriber;
+
+// A broadcast ring written by the engine's thread. Publishing is a few
+// stores and never waits for anyone; every subscriber reads at its own
+// pace from any thread. A subscriber that falls more than the capacity
+// behind loses the oldest events and counts them.
+class EventBus
+{
+public:
+    // Rounded up to a power of two
+    explicit EventBus(int capacity);
+    EventBus(const EventBus&) = delete;
+    EventBus& operator = (const EventBus&) = delete;
+
+    // Only ever from the producing thread
+    void publish(EngineEventType type, int value, int x, int y, long long tick);
+    // Sees the events published from now on
+    EventSubscriber subscribe() const;
+
+private:
+    friend class EventSubscriber;
+
+    // A seqlock per slot, odd while the producer writes it. The event is
+    // stored as words so a reader racing the producer stays defined.
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint64_t> words[3];
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    uint64_t mMask;
+    // Position of the next event
+    alignas(64) std::atomic<uint64_t> mHead;
+};
+
+class EventSubscriber
+{
+public:
+    EventSubscriber();
+    // Copies the next event, false once the subscriber caught up
+    bool poll(EngineEvent& event);
+    // Events overwritten before this subscriber read them
+    uint64_t getDropped() const;
+
+private:
+    friend class EventBus;
+    EventSubscriber(const EventBus* bus, uint64_t cursor);
+
+    const EventBus* mBus;
+    uint64_t mCursor;
+    uint64_t mDropped;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+
+#include "eventloop.h"
+
+EventLoop::WaitAwaiter::WaitAwaiter(EventLoop& loop, int fd, Clock::time_point deadline, int otherFd)
+    : mLoop(loop), mFd(fd), mOtherFd(otherFd), mDeadline(deadline), mReadable(false)
+{
+}
+
+bool EventLoop::WaitAwaiter::await_ready() const noexcept
+{
+    return false;
+}
+
+void EventLoop::WaitAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    // The awaiter lives in the suspended frame until the loop resumes it
+    this->mHandle = handle;
+    this->mLoop.mWaiters.push_back(this);
+}
+
+bool EventLoop::WaitAwaiter::await_resume() const noexcept
+{
+    return this->mReadable;
+}
+
+EventLoop::EventLoop()
+{
+}
+
+void EventLoop::spawn(Task<void>&& task)
+{
+    this->mTasks.push_back(std::move(task));
+    this->mTasks.back().start();
+}
+
+bool EventLoop::run()
+{
+    while (true)
+    {
+        // Finished tasks are dropped, their frames freed
+        this->mTasks.erase(std::remove_if(this->mTasks.begin(), this->mTasks.end(),
+            [](const Task<void>& task) { return task.done(); }), this->mTasks.end());
+        if (this->mTasks.empty() || this->mWaiters.empty())
+        {
+            return true;
+        }
+        if (!this->dispatch())
+        {
+            // Destroying the frames destroys the tasks they were awaiting
+            this->mWaiters.clear();
+            this->mTasks.clear();
+            return false;
+        }
+    }
+}
+
+EventLoop::WaitAwaiter EventLoop::sleepUntil(Clock::time_point deadline)
+{
+    return WaitAwaiter(*this, -1, deadline);
+}
+
+EventLoop::WaitAwaiter EventLoop::readable(int fd)
+{
+    return WaitAwaiter(*this, fd, Clock::time_point::max());
+}
+
+EventLoop::WaitAwaiter EventLoop::readable(int fd, Clock::time_point deadline)
+{
+    return WaitAwaiter(*this, fd, deadline);
+}
+
+EventLoop::WaitAwaiter EventLoop::readable(int fd, int otherFd, Clock::time_point deadline)
+{
+    return WaitAwaiter(*this, fd, deadline, otherFd);
+}
+
+bool EventLoop::dispatch()
+{
+    Clock::time_point deadline = Clock::time_point::max();
+    this->mPollFds.clear();
+    for (int i = 0; i < this->mWaiters.size(); i ++)
+    {
+        deadline = std::min(deadline, this->mWaiters[i]->mDeadline);
+        int fds[] = {this->mWaiters[i]->mFd, this->mWaiters[i]->mOtherFd};
+        for (int j = 0; j < 2; j ++)
+        {
+            if (fds[j] >= 0)
+            {
+                struct pollfd pfd;
+                pfd.fd = fds[j];
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                this->mPollFds.push_back(pfd);
+            }
+        }
+    }
+
+    struct timespec timeout;
+    struct timespec* timeoutPtr = nullptr;
+    if (deadline != Clock::time_point::max())
+    {
+        long long wait = std::max<long long>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count());
+        timeout.tv_sec = wait / 1000000000;
+        timeout.tv_nsec = wait % 1000000000;
+        timeoutPtr = &timeout;
+    }
+    // A signal such as SIGWINCH only cuts the wait short
+    if (ppoll(this->mPollFds.data(), this->mPollFds.size(), timeoutPtr, nullptr) < 0 && errno != EINTR)
+    {
+        return false;
+    }
+    // A closed descriptor would be reported on every ppoll without end
+    for (int i = 0; i < this->mPollFds.size(); i ++)
+    {
+        if (this->mPollFds[i].revents & POLLNVAL)
+        {
+            return false;
+        }
+    }
+
+    // Collected first, a resumed coroutine registers its next wait right away
+    Clock::time_point now = Clock::now();
+    this->mDue.clear();
+    int pollIndex = 0;
+    int kept = 0;
+    for (int i = 0; i < this->mWaiters.size(); i ++)
+    {
+        WaitAwaiter* waiter = this->mWaiters[i];
+        waiter->mReadable = false;
+        if (waiter->mFd >= 0)
+        {
+            waiter->mReadable = (this->mPollFds[pollIndex ++].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+        }
+        if (waiter->mOtherFd >= 0)
+        {
+            waiter->mReadable |= (this->mPollFds[pollIndex ++].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+        }
+        if (waiter->mReadable || waiter->mDeadline <= now)
+        {
+            this->mDue.push_back(waiter);
+        }
+        else
+        {
+            this->mWaiters[kept ++] = waiter;
+        }
+    }
+    this->mWaiters.resize(kept);
+    for (int i = 0; i < this->mDue.size(); i ++)
+    {
+        this->mDue[i]->mHandle.resume();
+    }
+    return true;
+}
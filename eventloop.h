@@ -0,0 +1,216 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+
+// A coroutine that starts suspended and runs once it is awaited or
+// spawned on an EventLoop. When it finishes it resumes whoever awaited it.
+template <class T>
+class Task;
+
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> mContinuation;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            // Spawned tasks have nobody waiting, the loop collects them
+            std::coroutine_handle<> continuation = handle.promise().mContinuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+    void unhandled_exception()
+    {
+        std::terminate();
+    }
+};
+
+template <class T>
+struct TaskPromise : TaskPromiseBase
+{
+    T mValue;
+
+    Task<T> get_return_object();
+    void return_value(T value)
+    {
+        this->mValue = std::move(value);
+    }
+    T result()
+    {
+        return std::move(this->mValue);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object();
+    void return_void()
+    {
+    }
+    void result()
+    {
+    }
+};
+
+template <class T>
+class Task
+{
+public:
+    typedef TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    explicit Task(Handle handle): mHandle(handle)
+    {
+    }
+    Task(Task&& other) noexcept: mHandle(std::exchange(other.mHandle, nullptr))
+    {
+    }
+    Task& operator = (Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            this->reset();
+            this->mHandle = std::exchange(other.mHandle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator = (const Task&) = delete;
+    ~Task()
+    {
+        this->reset();
+    }
+
+    bool done() const
+    {
+        return !this->mHandle || this->mHandle.done();
+    }
+    void start()
+    {
+        this->mHandle.resume();
+    }
+
+    // Awaiting runs the task right away, symmetric transfer keeps deep
+    // chains of awaits off the stack
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        this->mHandle.promise().mContinuation = awaiting;
+        return this->mHandle;
+    }
+    T await_resume()
+    {
+        return this->mHandle.promise().result();
+    }
+
+private:
+    void reset()
+    {
+        if (this->mHandle)
+        {
+            this->mHandle.destroy();
+            this->mHandle = nullptr;
+        }
+    }
+
+    Handle mHandle;
+};
+
+template <class T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+// Runs coroutines on one thread. A suspended coroutine waits on a
+// deadline, one or two readable file descriptors or both, and the loop sleeps in a
+// single ppoll until the first of them is due. Any number of spawned
+// tasks share the loop, a game and its menus or several headless sessions.
+class EventLoop
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    class WaitAwaiter
+    {
+    public:
+        WaitAwaiter(EventLoop& loop, int fd, Clock::time_point deadline, int otherFd = -1);
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle);
+        // True when a descriptor became readable, false on the deadline
+        bool await_resume() const noexcept;
+
+    private:
+        friend class EventLoop;
+        EventLoop& mLoop;
+        int mFd;
+        int mOtherFd;
+        Clock::time_point mDeadline;
+        std::coroutine_handle<> mHandle;
+        bool mReadable;
+    };
+
+    EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator = (const EventLoop&) = delete;
+
+    // Starts the task, the loop owns it until it finishes
+    void spawn(Task<void>&& task);
+    // Until every spawned task has finished. False when the loop could not
+    // wait any more, the tasks still waiting are dropped then.
+    bool run();
+
+    WaitAwaiter sleepUntil(Clock::time_point deadline);
+    WaitAwaiter readable(int fd);
+    WaitAwaiter readable(int fd, Clock::time_point deadline);
+    // Whichever of the two becomes readable first, such as the keyboard
+    // and a pipe the signal handlers write to
+    WaitAwaiter readable(int fd, int otherFd, Clock::time_point deadline);
+
+private:
+    // One ppoll, then every waiter that is due is resumed. False when
+    // ppoll failed or a descriptor is not open, as no wait could end then.
+    bool dispatch();
+
+    std::vector<Task<void> > mTasks;
+    std::vector<WaitAwaiter*> mWaiters;
+    // Reused by every dispatch so a steady loop does not allocate
+    std::vector<WaitAwaiter*> mDue;
+    std::vector<struct pollfd> mPollFds;
+};
+
+#endif
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// For the in-memory terminal and the scratch directory
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <curses.h>
+
+#include "framebench.h"
+#include "controller.h"
+#include "game.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const int gDirectionX[] = {0, 0, -1, 1};
+static const int gDirectionY[] = {-1, 1, 0, 0};
+static const int gDirectionKeys[] = {'w', 's', 'a', 'd'};
+// The in-memory terminal is emptied once it holds this much
+static const long long gOutputLimit = 64 << 20;
+
+FrameBench::FrameBench(const FrameBenchParams& params)
+    : mParams(params), mOutputFd(-1), mInputFd(-1), mStats(nullptr), mFrames(0), mLastTick(-1), mLastBucket(-1),
+      mLastOffset(0), mPoints(0), mLastMeal(0)
+{
+    // A ghost lives through deadly cells, the rounds could no longer be
+    // told apart from a death about to happen
+    this->mParams.rules.powerUpInterval = 0;
+    this->mParams.mapParams.movingObstacleNum = 0;
+}
+
+int FrameBench::getBucket(int length) const
+{
+    int bucket = 0;
+    while (bucket < this->mParams.lengthBounds.size() && length >= this->mParams.lengthBounds[bucket])
+    {
+        bucket ++;
+    }
+    return bucket;
+}
+
+bool FrameBench::run()
+{
+    // Curses is told which terminal to draw for, the bytes depend on it
+    const char* terminal = std::getenv("TERM");
+    terminal = terminal != nullptr ? terminal : "xterm";
+    FILE* probeOutput = std::fopen("/dev/null", "w");
+    FILE* probeInput = std::fopen("/dev/null", "r");
+    SCREEN* probe = probeOutput != nullptr && probeInput != nullptr ? newterm(terminal, probeOutput, probeInput) : nullptr;
+    if (probe != nullptr)
+    {
+        delscreen(probe);
+    }
+    if (probeOutput != nullptr)
+    {
+        std::fclose(probeOutput);
+    }
+    if (probeInput != nullptr)
+    {
+        std::fclose(probeInput);
+    }
+    if (probe == nullptr)
+    {
+        std::cerr << "No terminal description for " << terminal << std::endl;
+        return false;
+    }
+    setenv("TERM", terminal, 1);
+
+    // The rounds are recorded in a directory of their own
+    char directory[] = "/tmp/snake-frames-XXXXXX";
+    int workingDirectory = open(".", O_RDONLY | O_DIRECTORY);
+    if (workingDirectory < 0 || mkdtemp(directory) == nullptr || chdir(directory) != 0)
+    {
+        std::cerr << "Failed to create a directory for the game" << std::endl;
+        if (workingDirectory >= 0)
+        {
+            close(workingDirectory);
+        }
+        return false;
+    }
+
+    std::cout << std::left << std::setw(10) << "terminal" << std::setw(8) << "length" << std::setw(9) << "frames"
+        << std::setw(9) << "fps" << std::setw(9) << "frame" << std::setw(9) << "engine" << std::setw(9) << "render"
+        << "bytes/frame" << std::endl;
+    bool ok = true;
+    for (int i = 0; ok && i < this->mParams.columns.size() && i < this->mParams.rows.size(); i ++)
+    {
+        int columns = this->mParams.columns[i];
+        int rows = this->mParams.rows[i];
+        std::vector<FrameStats> stats(this->mParams.lengthBounds.size() + 1);
+        ok = this->measureGame(columns, rows, stats);
+        if (!ok)
+        {
+            break;
+        }
+        // The board the game had once the side panels took their share
+        this->measureEngine(columns - Game::kInstructionWidth, rows - Game::kInformationHeight, this->mFrames, stats);
+        std::string size = std::to_string(columns) + "x" + std::to_string(rows);
+        for (int j = 0; j < stats.size(); j ++)
+        {
+            if (stats[j].frames == 0)
+            {
+                continue;
+            }
+            std::string length = j < this->mParams.lengthBounds.size()
+                ? "<" + std::to_string(this->mParams.lengthBounds[j])
+                : ">=" + std::to_string(this->mParams.lengthBounds.back());
+            double frame = stats[j].seconds * 1e6 / stats[j].frames;
+            double engine = stats[j].engineTicks > 0 ? stats[j].engineSeconds * 1e6 / stats[j].engineTicks : 0;
+            std::cout << std::setw(10) << size << std::setw(8) << length << std::setw(9) << stats[j].frames
+                << std::fixed << std::setprecision(0) << std::setw(9) << stats[j].frames / stats[j].seconds
+                << std::setprecision(1) << std::setw(9) << frame << std::setw(9) << engine
+                << std::setw(9) << std::to_string((int)(100 * std::max(0.0, frame - engine) / frame)) + "%"
+                << (double)stats[j].bytes / stats[j].frames << std::endl;
+        }
+    }
+    std::cout << "frame and engine in microseconds, render is the share of a frame spent outside the engine: keys, drawing and terminal output" << std::endl;
+
+    const char* files[] = {"record.dat", "record.dat.tmp", "record.shm", "snapshot.dat", "snapshot.dat.tmp"};
+    for (int i = 0; i < 5; i ++)
+    {
+        unlink(files[i]);
+    }
+    if (fchdir(workingDirectory) != 0)
+    {
+        ok = false;
+    }
+    close(workingDirectory);
+    rmdir(directory);
+    return ok;
+}
+
+bool FrameBench::measureGame(int columns, int rows, std::vector<FrameStats>& stats)
+{
+    int pipeFds[2];
+    this->mOutputFd = memfd_create("snake-frames", 0);
+    if (this->mOutputFd < 0 || pipe(pipeFds) != 0)
+    {
+        std::cerr << "Failed to create the game's terminal" << std::endl;
+        if (this->mOutputFd >= 0)
+        {
+            close(this->mOutputFd);
+        }
+        return false;
+    }
+    this->mInputFd = pipeFds[1];
+    FILE* output = fdopen(this->mOutputFd, "w");
+    FILE* input = fdopen(pipeFds[0], "r");
+    this->mStats = &stats;
+    this->mFrames = 0;
+    this->mLastTick = -1;
+    this->mLastBucket = -1;
+    this->mLastOffset = 0;
+
+    // Curses takes the size from these when the output is no terminal
+    setenv("COLUMNS", std::to_string(columns).c_str(), 1);
+    setenv("LINES", std::to_string(rows).c_str(), 1);
+    {
+        Game game(output, input);
+        game.getMapGenParams() = this->mParams.mapParams;
+        game.getRules() = this->mParams.rules;
+        game.setBaseDelay(0);
+        game.setKeyScript([this](Engine& engine) { return this->playTick(engine); });
+        game.startGame();
+    }
+    unsetenv("COLUMNS");
+    unsetenv("LINES");
+    std::fclose(output);
+    std::fclose(input);
+    close(this->mInputFd);
+    this->mStats = nullptr;
+    return true;
+}
+
+int FrameBench::playTick(Engine& engine)
+{
+    Clock::time_point now = Clock::now();
+    long long offset = lseek(this->mOutputFd, 0, SEEK_CUR);
+    long long tick = engine.getTickCount();
+    // The first tick of a round follows the menu and the round's setup,
+    // only the frames between two ticks of a round are counted
+    if (tick == this->mLastTick + 1 && this->mLastBucket >= 0)
+    {
+        FrameStats& stats = (*this->mStats)[this->mLastBucket];
+        stats.frames ++;
+        stats.seconds += std::chrono::duration<double>(now - this->mLastTime).count();
+        stats.bytes += offset - this->mLastOffset;
+        this->mFrames ++;
+    }
+    if (offset > gOutputLimit)
+    {
+        // Curses writes at the file offset, it carries on at the start
+        if (ftruncate(this->mOutputFd, 0) == 0)
+        {
+            lseek(this->mOutputFd, 0, SEEK_SET);
+            offset = 0;
+        }
+    }
+    if (tick < this->mLastTick || this->mLastTick < 0 || engine.getPoints() != this->mPoints)
+    {
+        this->mPoints = engine.getPoints();
+        this->mLastMeal = tick;
+    }
+
+    Direction direction = GreedyController::chooseDirection(engine);
+    const SnakeBody& head = engine.getSnake().getSnake()[0];
+    int index = static_cast<int>(direction);
+    bool dying = engine.isDeadly(head.getX() + gDirectionX[index], head.getY() + gDirectionY[index]);
+    bool done = this->mFrames >= this->mParams.frames;
+    // Restart sits above Quit in the restart menu, the pause menu has
+    // Continue, Restart and Quit
+    const char* keys = nullptr;
+    if (dying)
+    {
+        keys = done ? "s\n" : "\n";
+    }
+    else if (done)
+    {
+        keys = "pss\n";
+    }
+    else if (tick - this->mLastMeal >= this->mParams.starvationTicks)
+    {
+        keys = "ps\n";
+    }
+    if (keys != nullptr && write(this->mInputFd, keys, std::strlen(keys)) < 0)
+    {
+        std::cerr << "Failed to send keys to the game" << std::endl;
+    }
+
+    this->mLastTick = tick;
+    this->mLastBucket = this->getBucket(engine.getSnake().getLength());
+    this->mLastOffset = offset;
+    this->mLastTime = now;
+    return gDirectionKeys[index];
+}
+
+void FrameBench::measureEngine(int width, int height, long long ticks, std::vector<FrameStats>& stats)
+{
+    Engine engine(width, height, this->mParams.mapParams, 2);
+    engine.setRules(this->mParams.rules);
+    unsigned int seed = this->mParams.seed;
+    while (ticks > 0)
+    {
+        engine.initializeRound(seed ++);
+        engine.spawnItems();
+        int points = 0;
+        long long lastMeal = 0;
+        while (ticks > 0 && !engine.isDead() && engine.getTickCount() - lastMeal < this->mParams.starvationTicks)
+        {
+            engine.getSnake().changeDirection(GreedyController::chooseDirection(engine));
+            FrameStats& bucket = stats[this->getBucket(engine.getSnake().getLength())];
+            Clock::time_point before = Clock::now();
+            engine.step(0);
+            bucket.engineSeconds += std::chrono::duration<double>(Clock::now() - before).count();
+            bucket.engineTicks ++;
+            ticks --;
+            if (engine.getPoints() != points)
+            {
+                points = engine.getPoints();
+                lastMeal = engine.getTickCount();
+            }
+        }
+    }
+}
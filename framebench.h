@@ -0,0 +1,77 @@
+#ifndef FRAMEBENCH_H
+#define FRAMEBENCH_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "map.h"
+#include "rules.h"
+#include "engine.h"
+
+struct FrameBenchParams
+{
+    // Frames drawn on every terminal size
+    int frames = 100000;
+    // Columns and rows of every terminal tried
+    std::vector<int> columns = {80, 120, 200};
+    std::vector<int> rows = {24, 40, 60};
+    // Frames are reported by snake length, in buckets below each bound
+    // and a last one for the longer snakes
+    std::vector<int> lengthBounds = {8, 32, 128};
+    // A round is given up once the snake goes this long without food
+    int starvationTicks = 1000;
+    MapGenParams mapParams;
+    RuleParams rules;
+    unsigned int seed = 1;
+};
+
+// Time and output of the frames drawn while the snake was in one length
+// bucket, and the engine's own time for as many ticks
+struct FrameStats
+{
+    long long frames = 0;
+    double seconds = 0;
+    long long bytes = 0;
+    long long engineTicks = 0;
+    double engineSeconds = 0;
+};
+
+// Plays the whole game, input, the engine's step and every render, with
+// no delay between ticks and its screen drawn into an in-memory file.
+// The frame rate and the bytes curses sends per frame, set against the
+// engine stepping the same rounds alone, tell whether the ticks go to
+// rendering or to the simulation.
+class FrameBench
+{
+public:
+    explicit FrameBench(const FrameBenchParams& params);
+    // Prints the frame rate and bytes per frame of every terminal size
+    bool run();
+
+private:
+    // Plays one terminal size until enough frames were drawn, false if
+    // the game's terminal could not be set up
+    bool measureGame(int columns, int rows, std::vector<FrameStats>& stats);
+    // The same kind of rounds on the same board, stepped without curses
+    void measureEngine(int width, int height, long long ticks, std::vector<FrameStats>& stats);
+    // Called by the game before every tick: accounts the frame drawn
+    // since the last call, steers, and ends rounds through the menus
+    int playTick(Engine& engine);
+    int getBucket(int length) const;
+
+    FrameBenchParams mParams;
+    // The terminal the game draws into and the keys it reads
+    int mOutputFd;
+    int mInputFd;
+    std::vector<FrameStats>* mStats;
+    long long mFrames;
+    long long mLastTick;
+    int mLastBucket;
+    long long mLastOffset;
+    std::chrono::steady_clock::time_point mLastTime;
+    int mPoints;
+    long long mLastMeal;
+};
+
+#endif
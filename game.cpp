@@ -1,21 +1,86 @@
 #include <string>
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <ctime>
 
 // For terminal delay
 #include <chrono>
-#include <thread>
 
-#include <fstream>
 #include <algorithm>
+#include <cstdlib>
+
+// For terminal resize
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include "game.h"
+#include "alloccount.h"
+#include "metrics.h"
+
+// Every handler writes a byte here, so a game sleeping in the event loop
+// wakes for the signal as it would for a key
+static int gSignalPipe[2] = {-1, -1};
+
+static void wakeSignalPipe()
+{
+    int savedErrno = errno;
+    char byte = 0;
+    // A full pipe already holds a wake-up
+    if (gSignalPipe[1] >= 0 && write(gSignalPipe[1], &byte, 1) < 0)
+    {
+    }
+    errno = savedErrno;
+}
+
+static void drainSignalPipe()
+{
+    char bytes[64];
+    while (read(gSignalPipe[0], bytes, sizeof(bytes)) > 0)
+    {
+    }
+}
+
+// Set by the SIGWINCH handler, consumed by Game::pollResize
+static volatile std::sig_atomic_t gResizePending = 0;
+
+static void handleResizeSignal(int)
+{
+    gResizePending = 1;
+    wakeSignalPipe();
+}
+
+// Set by the SIGTERM and SIGTSTP handlers, the round is saved and the
+// process ends or stops once the game wakes up next
+static volatile std::sig_atomic_t gSuspendSignal = 0;
 
-Game::Game()
+static void handleSuspendSignal(int signal)
 {
+    gSuspendSignal = signal;
+    wakeSignalPipe();
+}
+
+Game::Game(FILE* output, FILE* input)
+{
+    // Saved before curses installs its own handlers
+    sigaction(SIGWINCH, nullptr, &this->mPreviousResizeAction);
+    sigaction(SIGTERM, nullptr, &this->mPreviousTermAction);
+    sigaction(SIGTSTP, nullptr, &this->mPreviousStopAction);
     // Separate the screen to three windows
     this->mWindows.resize(3);
-    initscr();
+    if (output != nullptr && input != nullptr)
+    {
+        const char* terminal = std::getenv("TERM");
+        this->mScreen = newterm(terminal != nullptr ? terminal : "xterm", output, input);
+        this->mInputFd = fileno(input);
+    }
+    else
+    {
+        initscr();
+    }
     // If there wasn't any key pressed don't wait for keypress
     nodelay(stdscr, true);
     // Turn on keypad control
@@ -24,17 +89,34 @@ Game::Game()
     noecho();
     // No cursor show
     curs_set(0);
+    // Seeds the generated boards, the snake used to be the first to need it
+    std::srand(std::time(nullptr));
+    // Shared by every game in the process, like the handlers
+    if (gSignalPipe[0] < 0 && pipe2(gSignalPipe, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        gSignalPipe[0] = gSignalPipe[1] = -1;
+    }
+    // Take over SIGWINCH from curses so a burst of resizes relayouts only once
+    struct sigaction action = {};
+    action.sa_handler = handleResizeSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, nullptr);
+    // Curses' own handlers would end or stop the game before it is saved
+    action.sa_handler = handleSuspendSignal;
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGTSTP, &action, nullptr);
     // Get screen and board parameters
     getmaxyx(stdscr, this->mScreenHeight, this->mScreenWidth);
-    this->mGameBoardWidth = this->mScreenWidth - this->mInstructionWidth;
-    this->mGameBoardHeight = this->mScreenHeight - this->mInformationHeight;
+    this->mGameBoardWidth = this->mScreenWidth - kInstructionWidth;
+    this->mGameBoardHeight = this->mScreenHeight - kInformationHeight;
 
     this->createInformationBoard();
     this->createGameBoard();
     this->createInstructionBoard();
 
-    // Initialize the leader board to be all zeros
-    this->mLeaderBoard.assign(this->mNumLeaders, 0);
+    this->readLeaderBoard();
+    this->mLeaderBoardWriter.reset(new LeaderboardWriter(this->mLeaderBoard));
 }
 
 Game::~Game()
@@ -44,13 +126,22 @@ Game::~Game()
         delwin(this->mWindows[i]);
     }
     endwin();
+    if (this->mScreen != nullptr)
+    {
+        delscreen(this->mScreen);
+    }
+    sigaction(SIGWINCH, &this->mPreviousResizeAction, nullptr);
+    sigaction(SIGTERM, &this->mPreviousTermAction, nullptr);
+    sigaction(SIGTSTP, &this->mPreviousStopAction, nullptr);
+    // Waits for the queued rounds to reach the disk
+    this->mLeaderBoardWriter.reset();
 }
 
 void Game::createInformationBoard()
 {
     int startY = 0;
     int startX = 0;
-    this->mWindows[0] = newwin(this->mInformationHeight, this->mScreenWidth, startY, startX);
+    this->mWindows[0] = newwin(kInformationHeight, this->mScreenWidth, startY, startX);
 }
 
 void Game::renderInformationBoard() const
@@ -64,9 +155,9 @@ void Game::renderInformationBoard() const
 
 void Game::createGameBoard()
 {
-    int startY = this->mInformationHeight;
+    int startY = kInformationHeight;
     int startX = 0;
-    this->mWindows[1] = newwin(this->mScreenHeight - this->mInformationHeight, this->mScreenWidth - this->mInstructionWidth, startY, startX);
+    this->mWindows[1] = newwin(this->mScreenHeight - kInformationHeight, this->mScreenWidth - kInstructionWidth, startY, startX);
 }
 
 void Game::renderGameBoard() const
@@ -76,9 +167,9 @@ void Game::renderGameBoard() const
 
 void Game::createInstructionBoard()
 {
-    int startY = this->mInformationHeight;
-    int startX = this->mScreenWidth - this->mInstructionWidth;
-    this->mWindows[2] = newwin(this->mScreenHeight - this->mInformationHeight, this->mInstructionWidth, startY, startX);
+    int startY = kInformationHeight;
+    int startX = this->mScreenWidth - kInstructionWidth;
+    this->mWindows[2] = newwin(this->mScreenHeight - kInformationHeight, kInstructionWidth, startY, startX);
 }
 
 void Game::renderInstructionBoard() const
@@ -89,6 +180,7 @@ void Game::renderInstructionBoard() const
     mvwprintw(this->mWindows[2], 4, 1, "Down: S");
     mvwprintw(this->mWindows[2], 5, 1, "Left: A");
     mvwprintw(this->mWindows[2], 6, 1, "Right: D");
+    mvwprintw(this->mWindows[2], 7, 1, "Save: K");
 
     mvwprintw(this->mWindows[2], 8, 1, "Difficulty");
     mvwprintw(this->mWindows[2], 11, 1, "Points");
@@ -100,109 +192,135 @@ void Game::renderInstructionBoard() const
 void Game::renderLeaderBoard() const
 {
     // If there is not too much space, skip rendering the leader board
-    if (this->mScreenHeight - this->mInformationHeight - 14 - 2 < 3 * 2)
+    if (this->mScreenHeight - kInformationHeight - 14 - 2 < 3 * 2)
     {
         return;
     }
     mvwprintw(this->mWindows[2], 14, 1, "Leader Board");
-    std::string pointString;
-    std::string rank;
-    for (int i = 0; i < std::min(this->mNumLeaders, this->mScreenHeight - this->mInformationHeight - 14 - 2); i ++)
+    int rows = std::min(this->mNumLeaders, this->mScreenHeight - kInformationHeight - 14 - 2);
+    LeaderboardEntry leaders[mNumLeaders];
+    int leaderNum = this->mLeaderBoard.copyTop(leaders, rows);
+    for (int i = 0; i < rows; i ++)
     {
-        pointString = std::to_string(this->mLeaderBoard[i]);
-        rank = "#" + std::to_string(i + 1) + ":";
-        mvwprintw(this->mWindows[2], 14 + (i + 1), 1, rank.c_str());
-        mvwprintw(this->mWindows[2], 14 + (i + 1), 5, pointString.c_str());
+        mvwprintw(this->mWindows[2], 14 + (i + 1), 1, "#%d:", i + 1);
+        if (i >= leaderNum)
+        {
+            mvwprintw(this->mWindows[2], 14 + (i + 1), 5, "%-13d", 0);
+            continue;
+        }
+        mvwprintw(this->mWindows[2], 14 + (i + 1), 5, "%-6.6s %-6d", leaders[i].name, leaders[i].score);
     }
     wrefresh(this->mWindows[2]);
 }
 
-bool Game::renderRestartMenu() const
+Task<bool> Game::renderRestartMenu()
 {
     WINDOW * menu;
     int width = this->mGameBoardWidth * 0.5;
     int height = this->mGameBoardHeight * 0.5;
     int startX = this->mGameBoardWidth * 0.25;
-    int startY = this->mGameBoardHeight * 0.25 + this->mInformationHeight;
+    int startY = this->mGameBoardHeight * 0.25 + kInformationHeight;
 
     menu = newwin(height, width, startY, startX);
     box(menu, 0, 0);
-    std::vector<std::string> menuItems = {"Restart", "Quit"};
+    const char* menuItems[] = {"Restart", "Quit"};
+    const int numMenuItems = 2;
 
     int index = 0;
     int offset = 4;
     mvwprintw(menu, 1, 1, "Your Final Score:");
-    std::string pointString = std::to_string(this->mPoints);
-    mvwprintw(menu, 2, 1, pointString.c_str());
+    mvwprintw(menu, 2, 1, "%d", this->mPtrEngine->getPoints());
     wattron(menu, A_STANDOUT);
-    mvwprintw(menu, 0 + offset, 1, menuItems[0].c_str());
+    mvwprintw(menu, 0 + offset, 1, menuItems[0]);
     wattroff(menu, A_STANDOUT);
-    mvwprintw(menu, 1 + offset, 1, menuItems[1].c_str());
+    mvwprintw(menu, 1 + offset, 1, menuItems[1]);
 
     wrefresh(menu);
 
-    int key;
-    while (true)
+    int key = ERR;
+    while (key != ' ' && key != 10)
     {
-        key = getch();
-        switch(key)
+        // The menu sleeps until a key, a signal or a relayout that is due
+        co_await this->mLoop.readable(this->mInputFd, gSignalPipe[0], this->getResizeDeadline());
+        drainSignalPipe();
+        if (this->pollResize() && !this->mTooSmall)
         {
-            case 'W':
-            case 'w':
-            case KEY_UP:
+            // The relayout painted the board over the menu
+            touchwin(menu);
+            wrefresh(menu);
+        }
+        if (gSuspendSignal == SIGTSTP)
+        {
+            // The round is over, there is nothing to save
+            gSuspendSignal = 0;
+            this->stopProcess();
+        }
+        else if (gSuspendSignal == SIGTERM)
+        {
+            index = numMenuItems - 1;
+            break;
+        }
+        while ((key = getch()) != ERR)
+        {
+            switch(key)
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                index --;
-                index = (index < 0) ? menuItems.size() - 1 : index;
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
-                break;
+                case 'W':
+                case 'w':
+                case KEY_UP:
+                {
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    index --;
+                    index = (index < 0) ? numMenuItems - 1 : index;
+                    wattron(menu, A_STANDOUT);
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    wattroff(menu, A_STANDOUT);
+                    break;
+                }
+                case 'S':
+                case 's':
+                case KEY_DOWN:
+                {
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    index ++;
+                    index = (index > numMenuItems - 1) ? 0 : index;
+                    wattron(menu, A_STANDOUT);
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    wattroff(menu, A_STANDOUT);
+                    break;
+                }
             }
-            case 'S':
-            case 's':
-            case KEY_DOWN:
+            wrefresh(menu);
+            if (key == ' ' || key == 10)
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                index ++;
-                index = (index > menuItems.size() - 1) ? 0 : index;
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
                 break;
             }
         }
-        wrefresh(menu);
-        if (key == ' ' || key == 10)
-        {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     delwin(menu);
 
     if (index == 0)
     {
-        return true;
+        co_return true;
     }
     else
     {
-        return false;
+        co_return false;
     }
 
 }
 
-int Game::renderPauseMenu() const
+Task<int> Game::renderPauseMenu()
 {
         WINDOW * menu;
     int width = this->mGameBoardWidth * 0.5;
     int height = this->mGameBoardHeight * 0.5;
     int startX = this->mGameBoardWidth * 0.25;
-    int startY = this->mGameBoardHeight * 0.25 + this->mInformationHeight;
+    int startY = this->mGameBoardHeight * 0.25 + kInformationHeight;
 
     menu = newwin(height, width, startY, startX);
     box(menu, 0, 0);
-    std::vector<std::string> menuItems = {"Continue","Restart", "Quit"};
+    const char* menuItems[] = {"Continue","Restart", "Quit"};
+    const int numMenuItems = 3;
 
     int index = 0;
     int offset = 4;
@@ -210,84 +328,235 @@ int Game::renderPauseMenu() const
    // std::string pointString = std::to_string(this->mPoints);
    // mvwprintw(menu, 2, 1, pointString.c_str());
     wattron(menu, A_STANDOUT);
-    mvwprintw(menu, 0 + offset, 1, menuItems[0].c_str());
+    mvwprintw(menu, 0 + offset, 1, menuItems[0]);
     wattroff(menu, A_STANDOUT);
-    mvwprintw(menu, 1 + offset, 1, menuItems[1].c_str());
-    mvwprintw(menu, 2 + offset, 1, menuItems[2].c_str());
+    mvwprintw(menu, 1 + offset, 1, menuItems[1]);
+    mvwprintw(menu, 2 + offset, 1, menuItems[2]);
 
     wrefresh(menu);
 
-    int key;
-    while (true)
+    int key = ERR;
+    while (key != ' ' && key != 10)
     {
-        key = getch();
-        switch(key)
+        // The menu sleeps until a key, a signal or a relayout that is due
+        co_await this->mLoop.readable(this->mInputFd, gSignalPipe[0], this->getResizeDeadline());
+        drainSignalPipe();
+        if (this->pollResize() && !this->mTooSmall)
+        {
+            touchwin(menu);
+            wrefresh(menu);
+        }
+        // Continue, the round saves itself before it ends or stops
+        if (gSuspendSignal != 0)
         {
-            case 'W':
-            case 'w':
-            case KEY_UP:
+            index = 0;
+            break;
+        }
+        while ((key = getch()) != ERR)
+        {
+            switch(key)
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                index --;
-                index = (index < 0) ? menuItems.size() - 1 : index;
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
-                break;
+                case 'W':
+                case 'w':
+                case KEY_UP:
+                {
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    index --;
+                    index = (index < 0) ? numMenuItems - 1 : index;
+                    wattron(menu, A_STANDOUT);
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    wattroff(menu, A_STANDOUT);
+                    break;
+                }
+                case 'S':
+                case 's':
+                case KEY_DOWN:
+                {
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    index ++;
+                    index = (index > numMenuItems - 1) ? 0 : index;
+                    wattron(menu, A_STANDOUT);
+                    mvwprintw(menu, index + offset, 1, menuItems[index]);
+                    wattroff(menu, A_STANDOUT);
+                    break;
+                }
             }
-            case 'S':
-            case 's':
-            case KEY_DOWN:
+            wrefresh(menu);
+            if (key == ' ' || key == 10)
             {
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                index ++;
-                index = (index > menuItems.size() - 1) ? 0 : index;
-                wattron(menu, A_STANDOUT);
-                mvwprintw(menu, index + offset, 1, menuItems[index].c_str());
-                wattroff(menu, A_STANDOUT);
                 break;
             }
         }
-        wrefresh(menu);
-        if (key == ' ' || key == 10)
-        {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     delwin(menu);
 
     if (index == 0)
     {
-        return 1;
+        co_return 1;
     }
     else if (index == 1)
     {
-        return 2;
+        co_return 2;
     }
     else
-        return 3;
+        co_return 3;
 }
 
 void Game::renderPoints() const
 {
-    std::string pointString = std::to_string(this->mPoints);
-    mvwprintw(this->mWindows[2], 12, 1, pointString.c_str());
+    // Padded to clear a longer number from the last round
+    mvwprintw(this->mWindows[2], 12, 1, "%-*d", kInstructionWidth - 2, this->mPtrEngine->getPoints());
     wrefresh(this->mWindows[2]);
 }
 
 void Game::renderDifficulty() const
 {
-    std::string difficultyString = std::to_string(this->mDifficulty);
-    mvwprintw(this->mWindows[2], 9, 1, difficultyString.c_str());
+    mvwprintw(this->mWindows[2], 9, 1, "%-*d", kInstructionWidth - 2, this->mDifficulty);
+    wrefresh(this->mWindows[2]);
+}
+
+bool Game::loadLevelPack(const std::string& path, int levelIndex)
+{
+    Level level;
+    if (!this->mLevelPack.open(path) || !this->mLevelPack.getLevel(levelIndex, level))
+    {
+        this->mLevelPack.close();
+        return false;
+    }
+    this->mLevelIndex = levelIndex;
+    return true;
+}
+
+void Game::useWorld(int width, int height, unsigned int seed)
+{
+    this->mWorldWidth = width;
+    this->mWorldHeight = height;
+    this->mWorldSeed = seed;
+}
+
+MapGenParams& Game::getMapGenParams()
+{
+    return this->mMapGenParams;
+}
+
+RuleParams& Game::getRules()
+{
+    return this->mRules;
+}
+
+void Game::setDangerOverlay(bool enabled)
+{
+    this->mDangerOverlay = enabled;
+    // At most the four neighbours of the head
+    this->mDangerMarks.reserve(4);
+    if (this->mPtrEngine != nullptr)
+    {
+        this->mPtrEngine->setSpaceTracking(enabled);
+    }
+}
+
+bool Game::loadAutopilot(const std::string& path)
+{
+    std::unique_ptr<NeuralController> autopilot(new NeuralController());
+    if (!autopilot->load(path))
+    {
+        return false;
+    }
+    this->mAutopilot = std::move(autopilot);
+    return true;
+}
+
+void Game::setSnapshot(const std::string& path, bool resume)
+{
+    this->mSnapshotPath = path;
+    this->mResume = resume;
+}
+
+bool Game::hasResumeFailed() const
+{
+    return this->mResumeFailed;
+}
+
+bool Game::saveSnapshot()
+{
+    SnapshotHeader& header = this->mPtrEngine->saveSnapshot(this->mSnapshotBuffer);
+    header.difficulty = this->mDifficulty;
+    header.delay = this->mDelay;
+    header.levelIndex = this->mLevelPack.isOpen() ? this->mLevelIndex : -1;
+    header.levelChecksum = this->mLevelPack.getChecksum();
+    bool saved = SnapshotFile::write(this->mSnapshotPath, this->mSnapshotBuffer);
+    mvwprintw(this->mWindows[2], 13, 1, saved ? "Saved      " : "Save failed");
     wrefresh(this->mWindows[2]);
+    return saved;
+}
+
+bool Game::resumeSnapshot()
+{
+    SnapshotFile snapshot;
+    if (!snapshot.open(this->mSnapshotPath))
+    {
+        return false;
+    }
+    // Another level of the same size would take the body and the movers
+    // and put them on its own obstacles
+    const SnapshotHeader& header = snapshot.getHeader();
+    if ((header.board == SnapshotBoard::Level && (!this->mLevelPack.isOpen() || header.levelIndex != this->mLevelIndex
+        || header.levelChecksum != this->mLevelPack.getChecksum())) || !this->mPtrEngine->loadSnapshot(snapshot))
+    {
+        return false;
+    }
+    // The terminal may have changed size since, generated boards follow it
+    this->mPtrEngine->resizeBoard(this->mGameBoardWidth, this->mGameBoardHeight);
+    this->mDifficulty = header.difficulty;
+    this->mDelay = header.delay;
+    this->mScheduler.setInterval(std::chrono::milliseconds(this->mDelay));
+    return true;
+}
+
+void Game::stopProcess()
+{
+    endwin();
+    // The handler kept SIGTSTP from stopping us, this stops for real
+    raise(SIGSTOP);
+    // Continued, repaint everything curses had on the screen
+    clearok(curscr, true);
+    doupdate();
 }
 
 void Game::initializeGame()
 {
-    // allocate memory for a new snake
-		this->mPtrSnake.reset(new Snake(this->mGameBoardWidth, this->mGameBoardHeight, this->mInitialSnakeLength));
-		this->mPtrMap.reset(new Map(this->mGameBoardWidth, this->mGameBoardHeight, this->mInitialObstacleNum, this->mInitialPowerPathLength));
+    // allocate memory for the snake and the map once,
+    // later rounds reset them in place and reuse their storage
+    if (this->mPtrEngine == nullptr)
+    {
+        this->mMapGenParams.powerPathLength = this->mInitialPowerPathLength;
+        this->mPtrEngine.reset(new Engine(this->mGameBoardWidth, this->mGameBoardHeight, this->mMapGenParams, this->mInitialSnakeLength));
+        Level level;
+        if (this->mLevelIndex >= 0 && this->mLevelPack.getLevel(this->mLevelIndex, level))
+        {
+            this->mPtrEngine->loadLevel(level);
+        }
+        else if (this->mWorldWidth > 0)
+        {
+            this->mPtrEngine->initializeWorld(this->mWorldWidth, this->mWorldHeight, this->mWorldSeed);
+        }
+        this->mPtrEngine->setSpaceTracking(this->mDangerOverlay);
+        this->mPtrEngine->setRules(this->mRules);
+        this->mEvents = this->mPtrEngine->getEvents().subscribe();
+        this->mDelayCurve = selectDelayCurve(this->mRules.speed);
+    }
+    // The first round continues a saved one when asked to
+    bool resumed = this->mResume && this->resumeSnapshot();
+    this->mResumeFailed = this->mResume && !resumed;
+    this->mResume = false;
+    if (!resumed)
+    {
+        // The whole round follows from this seed
+        this->mPtrEngine->initializeRound(rand());
+    }
+    this->mViewX = 0;
+    this->mViewY = 0;
+    this->updateCamera();
 
     /* TODO
      * initialize the game pionts as zero
@@ -295,9 +564,20 @@ void Game::initializeGame()
      * make the snake aware of the food
      * other initializations
      */
-     this->mPoints = 0;
-     this->createRandomFood();
-     this->renderFood();
+     if (!resumed)
+     {
+         this->adjustDelay();
+     }
+     this->mScheduler.setRateScale(1.0);
+     this->mScheduler.reset();
+     this->mKeyCount = 0;
+     if (!resumed)
+     {
+         this->mPtrEngine->spawnItems();
+     }
+     this->renderFullBoard();
+     this->renderPoints();
+     this->renderDifficulty();
    //  int x = rand()%(this->mGameBoardWidth-1) + 1;
     // int y = rand()%(this->mGameBoardHeight-1) + 1;
     // SnakeBody food(x, y);
@@ -306,82 +586,205 @@ void Game::initializeGame()
     // wrefresh(this->mWindows[1]);
 }
 
-void Game::createRandomFood()
-{
-/* TODO
- * create a food at random places
- * make sure that the food doesn't overlap with the snake.
- */
-    int x, y, condition = 1;
-    while (condition) {
-        x = rand()%(this->mGameBoardWidth-1) + 1;
-        y = rand()%(this->mGameBoardHeight-2) + 1;
-        std::vector<SnakeBody>& s = this->mPtrSnake->getSnake();
-        std::vector<SnakeBody>& o = this->mPtrMap->getObstacle();
-        for (int i = 0; i < s.size(); i++){
-            int sx = (s[i]).getX();
-            int sy = (s[i]).getY();
-            if (x == sx && y == sy) {
-                condition = 2;
-                break;
+void Game::renderFood() const
+{
+    this->drawCell(this->mPtrEngine->getFood().getX(), this->mPtrEngine->getFood().getY(), this->mFoodSymbol);
+}
+
+void Game::renderPowerUp() const
+{
+    if (this->mPtrEngine->getPowerUp() != PowerUp::None)
+    {
+        const SnakeBody& cell = this->mPtrEngine->getPowerUpCell();
+        this->drawCell(cell.getX(), cell.getY(), this->mPowerUpSymbols[int(this->mPtrEngine->getPowerUp())]);
+    }
+}
+
+void Game::renderObstacle() const
+{
+    // Only the part of the map under the camera is looked at
+    int width = std::min(this->mPtrEngine->getMap().getWidth() - this->mViewX, this->mGameBoardWidth - 1);
+    int height = std::min(this->mPtrEngine->getMap().getHeight() - this->mViewY, this->mGameBoardHeight - 1);
+    for (int y = 1; y < height; y ++)
+    {
+        for (int x = 1; x < width; x ++)
+        {
+            if (this->mPtrEngine->getMap().isObstacle(this->mViewX + x, this->mViewY + y))
+            {
+                mvwaddch(this->mWindows[1], y, x, this->mObstacleSymbol);
             }
         }
-        for (int i = 0; i < o.size(); i++) {
-            int ox = (o[i]).getX();
-            int oy = (o[i]).getY();
-            if (x == ox && y == oy) {
-                condition = 2;
-                break;
+    }
+}
+
+void Game::renderPowerPath() const
+{
+    int width = std::min(this->mPtrEngine->getMap().getWidth() - this->mViewX, this->mGameBoardWidth - 1);
+    int height = std::min(this->mPtrEngine->getMap().getHeight() - this->mViewY, this->mGameBoardHeight - 1);
+    for (int y = 1; y < height; y ++)
+    {
+        for (int x = 1; x < width; x ++)
+        {
+            if (this->mPtrEngine->getMap().isPowerPath(this->mViewX + x, this->mViewY + y))
+            {
+                mvwaddch(this->mWindows[1], y, x, this->mPowerPathSymbol);
             }
         }
-        if (condition == 2) {
-            condition = 1;
-            continue;
-        }
-        else {
-            break;
-        }
     }
-    SnakeBody food(x, y);
-    mPtrSnake->senseFood(food);
-    this->mFood = food;
-   // mvwaddch(this->mWindows[1], y, x, this->mFoodSymbol);
-   // wrefresh(this->mWindows[1]);
 }
 
-void Game::renderFood() const
+void Game::renderSnake() const
 {
-    mvwaddch(this->mWindows[1], this->mFood.getY(), this->mFood.getX(), this->mFoodSymbol);
-    wrefresh(this->mWindows[1]);
+    int snakeLength = this->mPtrEngine->getSnake().getLength();
+    const BodyRing& snake = this->mPtrEngine->getSnake().getSnake();
+    for (int i = 0; i < snakeLength; i ++)
+    {
+        this->drawCell(snake[i].getX(), snake[i].getY(), this->mSnakeSymbol);
+    }
 }
 
-void Game::createRandomPowerPath()
+void Game::drawCell(int x, int y, char symbol) const
 {
-    return;
+    // The outermost row and column belong to the window's box
+    int windowX = x - this->mViewX;
+    int windowY = y - this->mViewY;
+    if (windowX < 1 || windowX >= this->mGameBoardWidth - 1 || windowY < 1 || windowY >= this->mGameBoardHeight - 1)
+    {
+        return;
+    }
+    mvwaddch(this->mWindows[1], windowY, windowX, symbol);
 }
 
-void Game::renderObstacle() const
+void Game::renderBackground(const SnakeBody& cell) const
 {
-    int length = this->mPtrMap->getObstacleNum();
-    std::vector<SnakeBody>& obstacle = this->mPtrMap->getObstacle();
-    for (int i = 0; i < length; i ++)
+    // What a cell shows once the snake or a mover has left it
+    char symbol = ' ';
+    if (this->mPtrEngine->getMap().isObstacle(cell.getX(), cell.getY()))
+    {
+        symbol = this->mObstacleSymbol;
+    }
+    else if (this->mPtrEngine->getPowerUp() != PowerUp::None && cell == this->mPtrEngine->getPowerUpCell())
+    {
+        symbol = this->mPowerUpSymbols[int(this->mPtrEngine->getPowerUp())];
+    }
+    else if (this->mPtrEngine->getMap().isPowerPath(cell.getX(), cell.getY()))
     {
-        mvwaddch(this->mWindows[1], obstacle[i].getY(), obstacle[i].getX(), this->mObstacleSymbol);
+        symbol = this->mPowerPathSymbol;
     }
+    this->drawCell(cell.getX(), cell.getY(), symbol);
+}
+
+void Game::renderFullBoard()
+{
+    werase(this->mWindows[1]);
+    box(this->mWindows[1], 0, 0);
+    this->renderPowerPath();
+    this->renderObstacle();
+    this->renderSnake();
+    this->renderPowerUp();
+    this->renderFood();
+    // The layers only draw, the window goes out once with all of them
     wrefresh(this->mWindows[1]);
+    this->mFullRedraw = false;
 }
 
-void Game::renderSnake() const
+void Game::renderDanger()
 {
-    int snakeLength = this->mPtrSnake->getLength();
-    std::vector<SnakeBody>& snake = this->mPtrSnake->getSnake();
-    for (int i = 0; i < snakeLength; i ++)
+    // Last tick's marks go first, the head or the food may have taken their cell
+    const BodyRing& snake = this->mPtrEngine->getSnake().getSnake();
+    const SnakeBody& food = this->mPtrEngine->getFood();
+    for (int i = 0; i < this->mDangerMarks.size(); i ++)
     {
-        mvwaddch(this->mWindows[1], snake[i].getY(), snake[i].getX(), this->mSnakeSymbol);
+        SnakeBody& mark = this->mDangerMarks[i];
+        if (!snake.empty() && mark == snake[0])
+        {
+            continue;
+        }
+        if (mark == food)
+        {
+            this->drawCell(food.getX(), food.getY(), this->mFoodSymbol);
+        }
+        else
+        {
+            this->renderBackground(mark);
+        }
+    }
+    this->mDangerMarks.clear();
+    if (snake.empty())
+    {
+        wrefresh(this->mWindows[1]);
+        return;
     }
+    const int dx[] = {0, 0, -1, 1};
+    const int dy[] = {-1, 1, 0, 0};
+    for (int i = 0; i < 4; i ++)
+    {
+        int x = snake[0].getX() + dx[i];
+        int y = snake[0].getY() + dy[i];
+        if (this->mPtrEngine->getReachability().isFree(x, y) && this->mPtrEngine->isTrap(x, y))
+        {
+            this->drawCell(x, y, this->mDangerSymbol);
+            this->mDangerMarks.push_back(SnakeBody(x, y));
+        }
+    }
+    wrefresh(this->mWindows[1]);
+}
+
+void Game::renderTickChanges(const SnakeStep& step) const
+{
+    // Only the cells that changed this tick are drawn: the dropped tail,
+    // the cells movers left and entered, the new head and the food
+    const BodyRing& snake = this->mPtrEngine->getSnake().getSnake();
+    for (int i = 0; i < step.freedNum; i ++)
+    {
+        this->renderBackground(step.freed[i]);
+    }
+    const std::vector<SnakeBody>& movedFrom = this->mPtrEngine->getMap().getMovedFrom();
+    const std::vector<SnakeBody>& movedTo = this->mPtrEngine->getMap().getMovedTo();
+    for (int i = 0; i < movedFrom.size(); i ++)
+    {
+        this->renderBackground(movedFrom[i]);
+        this->drawCell(movedTo[i].getX(), movedTo[i].getY(), this->mObstacleSymbol);
+    }
+    if (!snake.empty())
+    {
+        this->drawCell(snake[0].getX(), snake[0].getY(), this->mSnakeSymbol);
+    }
+    this->drawCell(this->mPtrEngine->getFood().getX(), this->mPtrEngine->getFood().getY(), this->mFoodSymbol);
     wrefresh(this->mWindows[1]);
 }
 
+bool Game::updateCamera()
+{
+    int viewX = this->mViewX;
+    int viewY = this->mViewY;
+    const BodyRing& snake = this->mPtrEngine->getSnake().getSnake();
+    if (!snake.empty())
+    {
+        // Recenter on the head once it enters the outer quarter of the window,
+        // so the board scrolls in jumps rather than on every move
+        int headX = snake[0].getX() - viewX;
+        int headY = snake[0].getY() - viewY;
+        int marginX = this->mGameBoardWidth / 4;
+        int marginY = this->mGameBoardHeight / 4;
+        if (headX < marginX || headX >= this->mGameBoardWidth - marginX)
+        {
+            viewX = snake[0].getX() - this->mGameBoardWidth / 2;
+        }
+        if (headY < marginY || headY >= this->mGameBoardHeight - marginY)
+        {
+            viewY = snake[0].getY() - this->mGameBoardHeight / 2;
+        }
+    }
+    viewX = std::max(0, std::min(viewX, this->mPtrEngine->getMap().getWidth() - this->mGameBoardWidth));
+    viewY = std::max(0, std::min(viewY, this->mPtrEngine->getMap().getHeight() - this->mGameBoardHeight));
+    bool moved = viewX != this->mViewX || viewY != this->mViewY;
+    this->mViewX = viewX;
+    this->mViewY = viewY;
+    this->mPtrEngine->setView(viewX, viewY, this->mGameBoardWidth, this->mGameBoardHeight);
+    return moved;
+}
+
 void Game::controlSnake(int key) const
 {
     //int key;
@@ -394,7 +797,7 @@ void Game::controlSnake(int key) const
         {
 				    // TODO change the direction of the snake.
 
-            this->mPtrSnake->changeDirection(Direction::Up);
+            this->mPtrEngine->getSnake().changeDirection(Direction::Up);
 
 
             break;
@@ -405,7 +808,7 @@ void Game::controlSnake(int key) const
         {
 				    // TODO change the direction of the snake.
 
-            this->mPtrSnake->changeDirection(Direction::Down);
+            this->mPtrEngine->getSnake().changeDirection(Direction::Down);
 
 
             break;
@@ -416,7 +819,7 @@ void Game::controlSnake(int key) const
         {
 				    // TODO change the direction of the snake.
 
-            this->mPtrSnake->changeDirection(Direction::Left);
+            this->mPtrEngine->getSnake().changeDirection(Direction::Left);
 
 
             break;
@@ -427,7 +830,7 @@ void Game::controlSnake(int key) const
         {
 				    // TODO change the direction of the snake.
 
-            this->mPtrSnake->changeDirection(Direction::Right);
+            this->mPtrEngine->getSnake().changeDirection(Direction::Right);
 
 
             break;
@@ -457,20 +860,196 @@ void Game::renderBoards() const
 }
 
 
+void Game::recordTickAllocations(std::size_t allocations)
+{
+    if (!allocationCountingEnabled())
+    {
+        return;
+    }
+    this->mTicks ++;
+    this->mTickAllocations = allocations;
+    // The first ticks warm up curses' internal buffers
+    if (this->mTicks > this->mAllocationWarmupTicks)
+    {
+        this->mMaxSteadyTickAllocations = std::max(this->mMaxSteadyTickAllocations, allocations);
+        this->mAllocatingTicks += allocations > 0 ? 1 : 0;
+        this->mSteadyAllocations += allocations;
+    }
+    mvwprintw(this->mWindows[2], this->mGameBoardHeight - 3, 1, "Allocs/tick");
+    mvwprintw(this->mWindows[2], this->mGameBoardHeight - 2, 1, "%zu max %zu ", this->mTickAllocations, this->mMaxSteadyTickAllocations);
+    wrefresh(this->mWindows[2]);
+}
+
+std::size_t Game::getSteadyTicks() const
+{
+    return this->mTicks > this->mAllocationWarmupTicks ? this->mTicks - this->mAllocationWarmupTicks : 0;
+}
+
+std::size_t Game::getAllocatingTicks() const
+{
+    return this->mAllocatingTicks;
+}
+
+std::size_t Game::getSteadyAllocations() const
+{
+    return this->mSteadyAllocations;
+}
+
+void Game::setBaseDelay(int delay)
+{
+    this->mBaseDelay = delay;
+}
+
+void Game::setKeyScript(std::function<int(Engine&)> script)
+{
+    this->mKeyScript = script;
+}
+
+std::chrono::steady_clock::time_point Game::getResizeDeadline() const
+{
+    return this->mResizeScheduled ? this->mResizeDeadline : std::chrono::steady_clock::time_point::max();
+}
+
+bool Game::pollResize()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (gResizePending)
+    {
+        // Every new signal pushes the deadline, so a drag redraws once at the end
+        gResizePending = 0;
+        this->mResizeScheduled = true;
+        this->mResizeDeadline = now + this->mResizeDebounce;
+    }
+    if (this->mResizeScheduled && now >= this->mResizeDeadline)
+    {
+        this->mResizeScheduled = false;
+        this->applyResize();
+        return true;
+    }
+    return false;
+}
+
+void Game::applyResize()
+{
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_row == 0 || size.ws_col == 0)
+    {
+        return;
+    }
+    resizeterm(size.ws_row, size.ws_col);
+    if (size.ws_col - kInstructionWidth < kMinBoardWidth || size.ws_row - kInformationHeight < kMinBoardHeight)
+    {
+        // The windows and the board keep their last size until it grows again
+        this->mTooSmall = true;
+        this->renderTooSmall();
+        return;
+    }
+    this->mTooSmall = false;
+    getmaxyx(stdscr, this->mScreenHeight, this->mScreenWidth);
+    this->mGameBoardWidth = this->mScreenWidth - kInstructionWidth;
+    this->mGameBoardHeight = this->mScreenHeight - kInformationHeight;
+
+    // Reuse the three windows, shrink them before moving so they always fit
+    wresize(this->mWindows[0], kInformationHeight, this->mScreenWidth);
+    wresize(this->mWindows[1], this->mGameBoardHeight, this->mGameBoardWidth);
+    wresize(this->mWindows[2], this->mGameBoardHeight, kInstructionWidth);
+    mvwin(this->mWindows[0], 0, 0);
+    mvwin(this->mWindows[1], kInformationHeight, 0);
+    mvwin(this->mWindows[2], kInformationHeight, this->mGameBoardWidth);
+
+    // Remap the playable area, the snake and the map keep their state.
+    // Levels and worlds keep their own bounds whatever the terminal size.
+    this->mPtrEngine->resizeBoard(this->mGameBoardWidth, this->mGameBoardHeight);
+
+    this->updateCamera();
+    clearok(curscr, true);
+    this->renderBoards();
+    this->renderFullBoard();
+    this->renderPoints();
+    this->renderDifficulty();
+}
+
+void Game::renderTooSmall() const
+{
+    erase();
+    mvprintw(0, 0, "Terminal too small");
+    mvprintw(1, 0, "Needs %dx%d", kMinBoardWidth + kInstructionWidth, kMinBoardHeight + kInformationHeight);
+    refresh();
+}
+
 void Game::adjustDelay()
 {
-    this->mDifficulty = this->mPoints / 5;
-    if (mPoints % 5 == 0)
+    this->mDifficulty = this->mPtrEngine->getPoints() / 5;
+    this->mDelay = this->mDelayCurve(this->mBaseDelay, this->mPtrEngine->getPoints());
+    this->mScheduler.setInterval(std::chrono::milliseconds(this->mDelay));
+}
+
+void Game::applyPowerPath()
+{
+    // One bit lookup, the effect is a rate on the scheduler so the
+    // difficulty's delay stays untouched
+    const BodyRing& snake = this->mPtrEngine->getSnake().getSnake();
+    bool onPowerPath = !snake.empty() && this->mPtrEngine->getMap().isPowerPath(snake[0].getX(), snake[0].getY());
+    this->mScheduler.setRateScale((onPowerPath ? this->mPowerPathSpeedup : 1.0) * this->mPtrEngine->getSpeedScale());
+}
+
+void Game::queueKey(int key)
+{
+    // A full queue drops the newest key, the player is far ahead of the snake
+    if (this->mKeyCount < mKeyQueueSize)
+    {
+        this->mKeyQueue[(this->mKeyHead + this->mKeyCount) % mKeyQueueSize] = key;
+        this->mKeyCount ++;
+    }
+}
+
+int Game::nextKey()
+{
+    if (this->mKeyCount == 0)
     {
-        this->mDelay = this->mBaseDelay * pow(0.75, this->mDifficulty);
+        return ERR;
     }
+    int key = this->mKeyQueue[this->mKeyHead];
+    this->mKeyHead = (this->mKeyHead + 1) % mKeyQueueSize;
+    this->mKeyCount --;
+    return key;
 }
 
-int Game::runGame()
+void Game::handleEvents()
+{
+    // Only the ticks that changed something pay for the side panel
+    EngineEvent event;
+    while (this->mEvents.poll(event))
+    {
+        switch (event.type)
+        {
+            case EngineEventType::FoodEaten:
+                this->renderPoints();
+                break;
+            case EngineEventType::DifficultyChanged:
+                this->adjustDelay();
+                this->renderDifficulty();
+                break;
+            case EngineEventType::PowerPathMoved:
+                this->mFullRedraw = true;
+                break;
+            case EngineEventType::PowerUpSpawned:
+                this->renderPowerUp();
+                break;
+            case EngineEventType::PowerUpRemoved:
+                this->renderBackground(SnakeBody(event.x, event.y));
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+Task<int> Game::runGame()
 {
-    int moveCondition;
     int keyOne, keyTwo;
     int condition;
+    bool pause = false;
     while (true)
     {
 				/* TODO
@@ -485,81 +1064,192 @@ int Game::runGame()
 				 *   7. render the position of the food and snake in the new frame of window.
 				 *   8. update other game states and refresh the window
 				 */
-        this->adjustDelay();
-
-
-        //clear();
-
-        keyOne = getch();
-       // keyTwo = getch();
-        if (keyOne == 'p' || keyOne == 'P') {
-            condition = renderPauseMenu();
-            if (condition == 1) {
+        if (gSuspendSignal != 0)
+        {
+            int signal = gSuspendSignal;
+            gSuspendSignal = 0;
+            this->saveSnapshot();
+            if (signal == SIGTERM)
+            {
+                co_return 4;
+            }
+            this->stopProcess();
+            // Back from the stop, the player picks the round up from the pause menu
+            pause = true;
+        }
+        if (this->mTooSmall)
+        {
+            // Nothing moves and keys are dropped until a resize makes room
+            co_await this->mLoop.readable(this->mInputFd, gSignalPipe[0], this->getResizeDeadline());
+            drainSignalPipe();
+            while (getch() != ERR)
+            {
+            }
+            if (this->pollResize() && !this->mTooSmall)
+            {
+                this->mScheduler.reset();
+            }
+            continue;
+        }
+        // Keys are taken the moment they arrive so a pause opens at once,
+        // the ticks still use one key each
+        // A signal wakes it too, the next pass handles it
+        if (!pause && co_await this->mLoop.readable(this->mInputFd, gSignalPipe[0], this->mScheduler.getNextTick()))
+        {
+            drainSignalPipe();
+            while ((keyOne = getch()) != ERR)
+            {
+                if (keyOne == 'p' || keyOne == 'P')
+                {
+                    pause = true;
+                    break;
+                }
+                else if (keyOne == 'k' || keyOne == 'K')
+                {
+                    this->saveSnapshot();
+                }
+                else
+                {
+                    this->queueKey(keyOne);
+                }
+                countMetric(MetricInputEvents);
+            }
+            if (!pause)
+            {
                 continue;
             }
+        }
+        if (pause) {
+            pause = false;
+            condition = co_await this->renderPauseMenu();
+            if (condition == 1) {
+                // The menu was drawn over the board
+                this->mFullRedraw = true;
+                this->mScheduler.reset();
+            }
             else if (condition == 2) {
-                return 2;
+                co_return 2;
            }
            else
-                return 3;
+                co_return 3;
+            continue;
+        }
+        std::size_t allocationsBefore = getAllocationCount();
+        std::chrono::steady_clock::time_point tickStart;
+        if (metricsEnabled())
+        {
+            tickStart = std::chrono::steady_clock::now();
+        }
+
+
+        //clear();
+
+        keyOne = this->nextKey();
+       // keyTwo = getch();
+        if (keyOne == ERR && this->mAutopilot != nullptr)
+        {
+            keyOne = this->mAutopilot->chooseKey(*this->mPtrEngine);
+        }
+        if (this->mKeyScript)
+        {
+            int scripted = this->mKeyScript(*this->mPtrEngine);
+            keyOne = scripted != ERR ? scripted : keyOne;
         }
         this->controlSnake(keyOne);
-        for (int i = 0; i < this->mPtrMap->getObstacle().size(); i++){
-                this->mPtrSnake->senseObstacle(this->mPtrMap->getObstacle()[i]);
+        if (this->pollResize() && this->mTooSmall)
+        {
+            continue;
         }
 
        // clear();
        // this->renderBoards();
-        werase(this->mWindows[1]);
-        box(this->mWindows[1], 0, 0);
-        moveCondition = this->mPtrSnake->moveFoward(keyOne);
-        if (moveCondition == 0){
-            this->createRandomFood();
-            this->mPoints += 1;
+        // Everything below is driven by what the head ran into
+        const SnakeStep& step = this->mPtrEngine->step(keyOne);
+        this->handleEvents();
+        this->applyPowerPath();
+        if (this->updateCamera() || this->mFullRedraw)
+        {
+            this->renderFullBoard();
+        }
+        else
+        {
+            this->renderTickChanges(step);
+        }
+        if (this->mDangerOverlay)
+        {
+            this->renderDanger();
+        }
+        // Another process on the host may have put a round on the board
+        uint64_t leaderBoardGeneration = this->mLeaderBoard.getGeneration();
+        if (leaderBoardGeneration != this->mLeaderBoardGeneration)
+        {
+            this->mLeaderBoardGeneration = leaderBoardGeneration;
+            this->renderLeaderBoard();
         }
-        this->renderSnake();
-        this->renderFood();
-        this->renderObstacle();
 
 
-        if (this->mPtrSnake->checkDeath(keyOne))
+        if (this->mPtrEngine->isDead())
             break;
 
 
 
 
 
-        this->renderPoints();
-        this->renderDifficulty();
+        this->recordTickAllocations(getAllocationCount() - allocationsBefore);
 
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(this->mDelay));
+        int dropped = this->mScheduler.advance();
 
         refresh();
+        if (metricsEnabled())
+        {
+            countMetric(MetricTicks);
+            countMetric(MetricFramesRendered);
+            countMetric(MetricFramesDropped, dropped);
+            setMetric(MetricSnakeLength, this->mPtrEngine->getSnake().getLength());
+            observeMetric(MetricTickTime, std::chrono::steady_clock::now() - tickStart);
+        }
     }
-    this->renderBoards();
+    // The last frame stays under the restart menu
+    refresh();
+    co_return 1;
 }
 
-void Game::startGame()
+bool Game::startGame()
 {
     refresh();
+    this->mLoop.spawn(this->playRounds());
+    return this->mLoop.run();
+}
+
+Task<void> Game::playRounds()
+{
     bool choice;
     int condition;
+    // The panels stay up between rounds, a restart only redraws the board
+    // and the fields that change; the leaderboard follows its generation
+    this->renderBoards();
     while (true)
     {
-        this->readLeaderBoard();
-        this->renderBoards();
         this->initializeGame();
-        condition = this->runGame();
-        this->updateLeaderBoard();
-        this->writeLeaderBoard();
+        condition = co_await this->runGame();
+        // A saved round is not over, it counts once it is resumed and ends
+        if (condition == 4)
+        {
+            break;
+        }
+        if (this->updateLeaderBoard())
+        {
+            this->writeLeaderBoard();
+            this->renderLeaderBoard();
+        }
         if (condition == 2){
             continue;
         }
         else if (condition == 3){
             break;
         }
-        choice = this->renderRestartMenu();
+        choice = co_await this->renderRestartMenu();
         if (choice == false)
         {
             break;
@@ -567,56 +1257,23 @@ void Game::startGame()
     }
 }
 
-// https://en.cppreference.com/w/cpp/io/basic_fstream
 bool Game::readLeaderBoard()
 {
-    std::fstream fhand(this->mRecordBoardFilePath, fhand.binary | fhand.in);
-    if (!fhand.is_open())
-    {
-        return false;
-    }
-    int temp;
-    int i = 0;
-    while ((!fhand.eof()) && (i < mNumLeaders))
-    {
-        fhand.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-        this->mLeaderBoard[i] = temp;
-        i ++;
-    }
-    fhand.close();
-    return true;
+    return this->mLeaderBoard.open(this->mSharedBoardFilePath, this->mLeaderBoardCapacity, this->mRecordBoardFilePath);
 }
 
 bool Game::updateLeaderBoard()
 {
-    bool updated = false;
-    int newScore = this->mPoints;
-    for (int i = 0; i < this->mNumLeaders; i ++)
-    {
-        if (this->mLeaderBoard[i] >= this->mPoints)
-        {
-            continue;
-        }
-        int oldScore = this->mLeaderBoard[i];
-        this->mLeaderBoard[i] = newScore;
-        newScore = oldScore;
-        updated = true;
-    }
-    return updated;
+    const char* name = std::getenv("USER");
+    this->mLastEntry = Leaderboard::makeEntry(name != nullptr ? name : "player", this->mPtrEngine->getPoints(),
+        this->mPtrEngine->getSnake().getLength(), this->mPtrEngine->getMap().getSeed());
+    // Rounds that do not make the top are never written
+    return this->mLeaderBoard.insert(this->mLastEntry);
 }
 
 bool Game::writeLeaderBoard()
 {
-    // trunc: clear the data file
-    std::fstream fhand(this->mRecordBoardFilePath, fhand.binary | fhand.trunc | fhand.out);
-    if (!fhand.is_open())
-    {
-        return false;
-    }
-    for (int i = 0; i < this->mNumLeaders; i ++)
-    {
-        fhand.write(reinterpret_cast<char*>(&this->mLeaderBoard[i]), sizeof(this->mLeaderBoard[i]));;
-    }
-    fhand.close();
+    // Queued, the round restarts without waiting for the disk
+    this->mLeaderBoardWriter->submit();
     return true;
 }
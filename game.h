@@ -2,18 +2,41 @@
 #define GAME_H
 
 #include "curses.h"
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <chrono>
+#include <csignal>
+#include <unistd.h>
 
 #include "snake.h"
 #include "map.h"
+#include "engine.h"
+#include "rules.h"
+#include "controller.h"
+#include "level.h"
+#include "scheduler.h"
+#include "sharedleaderboard.h"
+#include "leaderboardwriter.h"
+#include "eventloop.h"
 
 
 class Game
 {
 public:
-    Game();
+    // Rows of the information panel above the board and columns of the
+    // instruction panel right of it, the board gets the rest
+    static const int kInformationHeight = 6;
+    static const int kInstructionWidth = 18;
+    // Smallest board the menus and the leaderboard fit next to, a smaller
+    // terminal pauses the round until it grows again
+    static const int kMinBoardWidth = 40;
+    static const int kMinBoardHeight = 20;
+
+    // Draws to the terminal, or to output and reads keys from input when both are given
+    Game(FILE* output = nullptr, FILE* input = nullptr);
     ~Game();
 
 		void createInformationBoard();
@@ -33,25 +56,80 @@ public:
     void renderLeaderBoard() const;
 
 		void renderBoards() const;
-
+    // True when the screen was laid out again for a new terminal size
+    bool pollResize();
+    void applyResize();
+    // When a pending relayout is due, never while none is pending
+    std::chrono::steady_clock::time_point getResizeDeadline() const;
+
+    // Play a level from a binary level pack instead of the built-in map
+    bool loadLevelPack(const std::string& path, int levelIndex);
+    // Play on a sparse world far bigger than the terminal
+    void useWorld(int width, int height, unsigned int seed);
+    MapGenParams& getMapGenParams();
+    // Walls, obstacles, growth and speed of every round
+    RuleParams& getRules();
+    // Let a trained genome steer whenever no key is pressed
+    bool loadAutopilot(const std::string& path);
+    // Mark the cells next to the head that lead into pockets smaller than the snake
+    void setDangerOverlay(bool enabled);
+    // Where rounds are saved, with resume the first round continues the saved one
+    void setSnapshot(const std::string& path, bool resume);
+    bool hasResumeFailed() const;
+    bool saveSnapshot();
+    bool resumeSnapshot();
+    // Stops the process for SIGTSTP and repaints the screen once continued
+    void stopProcess();
 		void initializeGame();
-    int runGame();
+    // One round, ends on death (1), restart (2), quit (3) or when it was
+    // saved for SIGTERM (4)
+    Task<int> runGame();
     void renderPoints() const;
     void renderDifficulty() const;
 
-		void createRandomFood();
     void renderFood() const;
 
     void renderObstacle() const;
+    void renderPowerPath() const;
+    void renderPowerUp() const;
+    // Draw a map cell through the camera, cells outside the window are skipped
+    void drawCell(int x, int y, char symbol) const;
+    // Scroll the camera when the head nears the edge of the window
+    bool updateCamera();
     void renderSnake() const;
+    // Redraw everything under the camera, after a scroll, a menu or a new power path
+    void renderFullBoard();
+    // Redraw only the cells the last tick changed
+    void renderTickChanges(const SnakeStep& step) const;
+    void renderBackground(const SnakeBody& cell) const;
+    void renderDanger();
+    void renderTooSmall() const;
     void controlSnake(int key) const;
 
-    void createRandomPowerPath();
-
-		void startGame();
-    bool renderRestartMenu() const;
-    int renderPauseMenu() const;
+    void applyPowerPath();
+
+		// Runs the rounds on the event loop until the player quits, false
+		// when the loop stopped as it could no longer wait for input
+		bool startGame();
+    Task<void> playRounds();
+    Task<bool> renderRestartMenu();
+    Task<int> renderPauseMenu();
+    // Reacts to what the engine published during the last step
+    void handleEvents();
+    // Keys read between two ticks, each tick consumes one
+    void queueKey(int key);
+    int nextKey();
     void adjustDelay();
+    void recordTickAllocations(std::size_t allocations);
+    // Tick interval in milliseconds before any food is eaten
+    void setBaseDelay(int delay);
+    // Called before every tick, a key other than ERR is played in place
+    // of whatever the player or the autopilot chose
+    void setKeyScript(std::function<int(Engine&)> script);
+    // Ticks after the warm-up, how many of them allocated, and how often in total
+    std::size_t getSteadyTicks() const;
+    std::size_t getAllocatingTicks() const;
+    std::size_t getSteadyAllocations() const;
 
 
 private:
@@ -62,33 +140,97 @@ private:
     int mScreenHeight;
     int mGameBoardWidth;
     int mGameBoardHeight;
-    const int mInformationHeight = 6;
-    const int mInstructionWidth = 18;
     std::vector<WINDOW *> mWindows;
+    SCREEN* mScreen = nullptr;
+    // The handlers the game replaced, put back when it ends
+    struct sigaction mPreviousResizeAction;
+    struct sigaction mPreviousTermAction;
+    struct sigaction mPreviousStopAction;
+    // Where the keys come from, the loop waits on it
+    int mInputFd = STDIN_FILENO;
+    // Terminal resizes are applied once the SIGWINCH burst has settled
+    const std::chrono::milliseconds mResizeDebounce{100};
+    bool mResizeScheduled = false;
+    std::chrono::steady_clock::time_point mResizeDeadline;
+    // The terminal is below the minimum size, only the notice is shown
+    bool mTooSmall = false;
     // Snake information
     const int mInitialSnakeLength = 2;
     const char mSnakeSymbol = '@';
-    std::unique_ptr<Snake> mPtrSnake;
+    // The rules of the round, the game only renders and paces it
+    std::unique_ptr<Engine> mPtrEngine;
+    std::unique_ptr<NeuralController> mAutopilot;
+    EventSubscriber mEvents;
 
     // Food information
-    SnakeBody mFood;
     const char mFoodSymbol = '#';
 
-    const int mInitialObstacleNum = 10;
     const char mObstacleSymbol = '!';
     const int mInitialPowerPathLength = 10;
     const char mPowerPathSymbol = '*';
-    std::unique_ptr<Map> mPtrMap;
+    const char mDangerSymbol = 'x';
+    // Indexed by PowerUp: speed, shrink, ghost and multiplier
+    const char* mPowerUpSymbols = " >-G$";
+    bool mDangerOverlay = false;
+    std::vector<SnakeBody> mDangerMarks;
+    // Standing on a power path runs the snake this many times faster
+    const double mPowerPathSpeedup = 2.0;
+    // Every round is played on a freshly generated board
+    MapGenParams mMapGenParams;
+    RuleParams mRules;
+    DelayCurve mDelayCurve = SteppedSpeed::delay;
+    LevelPack mLevelPack;
+    int mLevelIndex = -1;
+    int mWorldWidth = 0;
+    int mWorldHeight = 0;
+    unsigned int mWorldSeed = 0;
+
+    bool mFullRedraw = true;
+
+    // Map coordinates of the top left corner of the game board window
+    int mViewX = 0;
+    int mViewY = 0;
 
 
-    int mPoints = 0;
     int mDifficulty = 0;
     int mBaseDelay = 100;
    // int mBaseDelay = 200;
     int mDelay;
+    TickScheduler mScheduler;
+    // The rounds, the menus and the tick timer all wait on this loop
+    EventLoop mLoop;
+    static const int mKeyQueueSize = 8;
+    int mKeyQueue[mKeyQueueSize];
+    int mKeyHead = 0;
+    int mKeyCount = 0;
+    // The log older versions kept, imported when the shared board is created
     const std::string mRecordBoardFilePath = "record.dat";
-    std::vector<int> mLeaderBoard;
-    const int mNumLeaders = 3;
+    const std::string mSharedBoardFilePath = "record.shm";
+    // The save key, SIGTERM and SIGTSTP save the round here
+    std::string mSnapshotPath = "snapshot.dat";
+    bool mResume = false;
+    bool mResumeFailed = false;
+    // Reused by every save, only a longer snake grows it
+    std::vector<unsigned char> mSnapshotBuffer;
+    // Keeps the best mLeaderBoardCapacity rounds, the panel shows mNumLeaders
+    const int mLeaderBoardCapacity = 1000;
+    // Mapped by every game process on the host, the panel is redrawn
+    // whenever any of them changes it
+    SharedLeaderboard mLeaderBoard;
+    uint64_t mLeaderBoardGeneration = 0;
+    std::unique_ptr<LeaderboardWriter> mLeaderBoardWriter;
+    LeaderboardEntry mLastEntry;
+    static constexpr int mNumLeaders = 3;
+
+    // Allocation accounting, only active with SNAKE_COUNT_ALLOCATIONS
+    const std::size_t mAllocationWarmupTicks = 10;
+    std::size_t mTicks = 0;
+    std::size_t mTickAllocations = 0;
+    std::size_t mMaxSteadyTickAllocations = 0;
+    std::size_t mAllocatingTicks = 0;
+    std::size_t mSteadyAllocations = 0;
+
+    std::function<int(Engine&)> mKeyScript;
 };
 
 #endif
@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// For the pseudo-terminal and the game process
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "latencybench.h"
+#include "game.h"
+#include "rules.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// What the output stream showed
+enum TerminalEvent
+{
+    TerminalNothing,
+    // A snake cell was drawn on the game board
+    TerminalSnake,
+    // The restart menu came up, the round is over
+    TerminalRoundOver,
+};
+
+// Follows the cursor through the VT100 output of curses. Curses only
+// sends the cells that changed, so every snake symbol in the stream is a
+// cell the snake has just entered.
+class TerminalTracker
+{
+public:
+    TerminalTracker(int columns, int rows)
+        : mColumns(columns), mRows(rows), mX(0), mY(0), mSavedX(0), mSavedY(0), mWrap(false),
+          mState(Text), mLast(' ')
+    {
+    }
+
+    TerminalEvent feed(unsigned char byte)
+    {
+        switch (this->mState)
+        {
+            case Escape:
+                return this->escape(byte);
+            case Charset:
+                this->mState = Text;
+                return TerminalNothing;
+            case Control:
+                return this->control(byte);
+            default:
+                break;
+        }
+        switch (byte)
+        {
+            case 0x1b:
+                this->mState = Escape;
+                return TerminalNothing;
+            case '\r':
+                this->moveTo(0, this->mY);
+                return TerminalNothing;
+            case '\n':
+                this->moveTo(this->mX, this->mY + 1);
+                return TerminalNothing;
+            case '\b':
+                this->moveTo(this->mX - 1, this->mY);
+                return TerminalNothing;
+            case '\t':
+                this->moveTo((this->mX / 8 + 1) * 8, this->mY);
+                return TerminalNothing;
+            default:
+                break;
+        }
+        return byte < 0x20 || byte == 0x7f ? TerminalNothing : this->print(byte);
+    }
+
+    // The cell of the last snake symbol
+    int getSnakeX() const
+    {
+        return this->mSnakeX;
+    }
+
+    int getSnakeY() const
+    {
+        return this->mSnakeY;
+    }
+
+private:
+    enum State
+    {
+        Text,
+        Escape,
+        // The character set designator after ESC ( or ESC )
+        Charset,
+        Control,
+    };
+
+    TerminalEvent print(unsigned char byte)
+    {
+        if (this->mWrap)
+        {
+            this->moveTo(0, this->mY + 1);
+        }
+        TerminalEvent event = TerminalNothing;
+        if (byte == '@' && this->mY > Game::kInformationHeight && this->mY < this->mRows - 1
+            && this->mX > 0 && this->mX < this->mColumns - Game::kInstructionWidth - 1)
+        {
+            this->mSnakeX = this->mX;
+            this->mSnakeY = this->mY;
+            event = TerminalSnake;
+        }
+        // "Your Final Score:" heads the restart menu
+        this->mRecent = this->mRecent.substr(this->mRecent.size() >= 16 ? 1 : 0) + char(byte);
+        if (this->mRecent.size() >= 6 && this->mRecent.compare(this->mRecent.size() - 6, 6, "Score:") == 0)
+        {
+            event = TerminalRoundOver;
+        }
+        this->mLast = byte;
+        if (this->mX == this->mColumns - 1)
+        {
+            this->mWrap = true;
+        }
+        else
+        {
+            this->mX ++;
+        }
+        return event;
+    }
+
+    TerminalEvent escape(unsigned char byte)
+    {
+        this->mState = Text;
+        switch (byte)
+        {
+            case '[':
+                this->mState = Control;
+                this->mParams.clear();
+                this->mParams.push_back(0);
+                break;
+            case '(':
+            case ')':
+                this->mState = Charset;
+                break;
+            case '7':
+                this->mSavedX = this->mX;
+                this->mSavedY = this->mY;
+                break;
+            case '8':
+                this->moveTo(this->mSavedX, this->mSavedY);
+                break;
+            case 'D':
+                this->moveTo(this->mX, this->mY + 1);
+                break;
+            case 'E':
+                this->moveTo(0, this->mY + 1);
+                break;
+            case 'M':
+                this->moveTo(this->mX, this->mY - 1);
+                break;
+            case 'c':
+                this->moveTo(0, 0);
+                break;
+            default:
+                break;
+        }
+        return TerminalNothing;
+    }
+
+    TerminalEvent control(unsigned char byte)
+    {
+        if (byte >= '0' && byte <= '9')
+        {
+            this->mParams.back() = this->mParams.back() * 10 + (byte - '0');
+            return TerminalNothing;
+        }
+        if (byte == ';')
+        {
+            this->mParams.push_back(0);
+            return TerminalNothing;
+        }
+        if (byte < 0x40 || byte > 0x7e)
+        {
+            // Private markers such as ?
+            return TerminalNothing;
+        }
+        this->mState = Text;
+        int first = std::max(1, this->mParams[0]);
+        int second = this->mParams.size() > 1 ? std::max(1, this->mParams[1]) : 1;
+        TerminalEvent event = TerminalNothing;
+        switch (byte)
+        {
+            case 'H':
+            case 'f':
+                this->moveTo(second - 1, first - 1);
+                break;
+            case 'A':
+                this->moveTo(this->mX, this->mY - first);
+                break;
+            case 'B':
+                this->moveTo(this->mX, this->mY + first);
+                break;
+            case 'C':
+                this->moveTo(this->mX + first, this->mY);
+                break;
+            case 'D':
+                this->moveTo(this->mX - first, this->mY);
+                break;
+            case 'G':
+                this->moveTo(first - 1, this->mY);
+                break;
+            case 'd':
+                this->moveTo(this->mX, first - 1);
+                break;
+            case 'b':
+                // Repeats the last character
+                for (int i = 0; i < first; i ++)
+                {
+                    TerminalEvent repeated = this->print(this->mLast);
+                    event = repeated != TerminalNothing ? repeated : event;
+                }
+                break;
+            default:
+                break;
+        }
+        return event;
+    }
+
+    void moveTo(int x, int y)
+    {
+        this->mX = std::max(0, std::min(this->mColumns - 1, x));
+        this->mY = std::max(0, std::min(this->mRows - 1, y));
+        this->mWrap = false;
+    }
+
+    int mColumns;
+    int mRows;
+    int mX;
+    int mY;
+    int mSavedX;
+    int mSavedY;
+    // Set after the last column was written, the next character wraps
+    bool mWrap;
+    State mState;
+    std::vector<int> mParams;
+    unsigned char mLast;
+    std::string mRecent;
+    int mSnakeX = 0;
+    int mSnakeY = 0;
+};
+
+LatencyBench::LatencyBench(const LatencyBenchParams& params): mParams(params), mRandom(params.seed)
+{
+}
+
+// Nearest rank, the latencies are sorted
+static double percentile(const std::vector<double>& latencies, double share)
+{
+    int rank = std::max(1, (int)std::ceil(share * latencies.size()));
+    return latencies[std::min<int>(rank, latencies.size()) - 1];
+}
+
+bool LatencyBench::run()
+{
+    char directory[] = "/tmp/snake-latency-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        std::cerr << "Failed to create a directory for the game" << std::endl;
+        return false;
+    }
+    this->mDirectory = directory;
+    std::cout << std::left << std::setw(10) << "terminal" << std::setw(12) << "difficulty" << std::setw(8) << "tick"
+        << std::setw(9) << "samples" << std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "p99"
+        << std::setw(8) << "max" << std::setw(10) << "restart" << std::setw(8) << "max" << "(ms)" << std::endl;
+    bool ok = true;
+    for (int i = 0; ok && i < this->mParams.columns.size() && i < this->mParams.rows.size(); i ++)
+    {
+        for (int j = 0; ok && j < this->mParams.difficulties.size(); j ++)
+        {
+            int delay = SteppedSpeed::delay(this->mParams.baseDelay, this->mParams.difficulties[j] * 5);
+            std::vector<double> latencies;
+            std::vector<double> restarts;
+            ok = this->measure(this->mParams.columns[i], this->mParams.rows[i], delay, latencies, restarts);
+            std::sort(latencies.begin(), latencies.end());
+            std::sort(restarts.begin(), restarts.end());
+            std::string terminal = std::to_string(this->mParams.columns[i]) + "x" + std::to_string(this->mParams.rows[i]);
+            std::cout << std::setw(10) << terminal << std::setw(12) << this->mParams.difficulties[j] << std::setw(8) << delay
+                << std::setw(9) << latencies.size() << std::fixed << std::setprecision(1);
+            if (!latencies.empty())
+            {
+                std::cout << std::setw(8) << percentile(latencies, 0.5) << std::setw(8) << percentile(latencies, 0.9)
+                    << std::setw(8) << percentile(latencies, 0.99) << std::setw(8) << latencies.back();
+            }
+            if (!restarts.empty())
+            {
+                std::cout << std::setw(10) << percentile(restarts, 0.5) << std::setw(8) << restarts.back();
+            }
+            std::cout << std::endl;
+        }
+    }
+    const char* files[] = {"record.dat", "record.dat.tmp", "record.shm", "snapshot.dat", "snapshot.dat.tmp"};
+    for (int i = 0; i < 5; i ++)
+    {
+        unlink((this->mDirectory + "/" + files[i]).c_str());
+    }
+    rmdir(this->mDirectory.c_str());
+    return ok;
+}
+
+bool LatencyBench::measure(int columns, int rows, int delay, std::vector<double>& latencies, std::vector<double>& restarts)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        if (master >= 0)
+        {
+            close(master);
+        }
+        return false;
+    }
+    std::string slaveName = ptsname(master);
+    std::string delayArgument = std::to_string(delay);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(master);
+        return false;
+    }
+    if (pid == 0)
+    {
+        // The game gets the terminal as its controlling one, sized as asked
+        setsid();
+        int slave = open(slaveName.c_str(), O_RDWR);
+        struct winsize size = {};
+        size.ws_col = columns;
+        size.ws_row = rows;
+        if (slave < 0 || ioctl(slave, TIOCSCTTY, 0) != 0 || ioctl(slave, TIOCSWINSZ, &size) != 0
+            || chdir(this->mDirectory.c_str()) != 0)
+        {
+            _exit(127);
+        }
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(slave);
+        close(master);
+        // The plainest terminal curses drives with cursor addressing
+        setenv("TERM", "vt100", 1);
+        unsetenv("LINES");
+        unsetenv("COLUMNS");
+        // No walls to run into, every tick takes the same time
+        execl("/proc/self/exe", "snake", "--density", "0", "--constant-speed", "--delay", delayArgument.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+
+    // The snake circles anticlockwise, one turn at a time
+    const char turnKeys[] = {'a', 's', 'd', 'w'};
+    int turn = 0;
+    bool measuring = false;
+    // Heads drawn since the round started, the first ones are the new snake
+    int heads = 0;
+    int keyX = 0;
+    int keyY = 0;
+    Clock::time_point keyTime;
+    Clock::time_point nextKey = Clock::time_point::max();
+    // Two to four cells between turns, too wide a loop for the snake to bite itself
+    std::uniform_real_distribution<double> pause(1.5, 3.5);
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(delay * 10 * this->mParams.samples
+        + (delay * rows + 1000) * this->mParams.restarts + 5000);
+    TerminalTracker tracker(columns, rows);
+    char buffer[1 << 16];
+    bool ok = true;
+    // Once the turns are in, the snake is steered into a wall and the
+    // round restarted until enough restarts were timed
+    bool restarting = false;
+    Clock::time_point restartTime;
+    while (latencies.size() < this->mParams.samples || restarts.size() < this->mParams.restarts)
+    {
+        Clock::time_point now = Clock::now();
+        if (now > deadline)
+        {
+            ok = false;
+            break;
+        }
+        if (!measuring && now >= nextKey && latencies.size() >= this->mParams.samples)
+        {
+            // Up, or on into the bottom wall when already heading down
+            const char key = 'w';
+            if (write(master, &key, 1) != 1)
+            {
+                ok = false;
+                break;
+            }
+            nextKey = Clock::time_point::max();
+        }
+        else if (!measuring && now >= nextKey)
+        {
+            const char key = turnKeys[turn];
+            keyX = tracker.getSnakeX();
+            keyY = tracker.getSnakeY();
+            keyTime = Clock::now();
+            if (write(master, &key, 1) != 1)
+            {
+                ok = false;
+                break;
+            }
+            measuring = true;
+            nextKey = Clock::time_point::max();
+        }
+        else if (measuring && now - keyTime > std::chrono::milliseconds(delay * 4 + 1000))
+        {
+            // The turn never showed, the snake died or ate its way into a long tail
+            measuring = false;
+            nextKey = now;
+        }
+        int timeout = -1;
+        if (nextKey != Clock::time_point::max())
+        {
+            timeout = std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(nextKey - now).count());
+        }
+        timeout = timeout < 0 ? 1000 : std::min(timeout, 1000);
+        struct pollfd poller = {master, POLLIN, 0};
+        if (poll(&poller, 1, timeout) <= 0)
+        {
+            continue;
+        }
+        ssize_t size = read(master, buffer, sizeof(buffer));
+        // Stamped once per read, a chunk is written by one refresh
+        Clock::time_point readTime = Clock::now();
+        if (size <= 0)
+        {
+            ok = false;
+            break;
+        }
+        for (ssize_t i = 0; i < size; i ++)
+        {
+            TerminalEvent event = tracker.feed(buffer[i]);
+            if (event == TerminalRoundOver)
+            {
+                // Restart is the menu's first choice, the new snake heads up
+                const char enter = '\n';
+                restartTime = Clock::now();
+                ok = write(master, &enter, 1) == 1;
+                restarting = true;
+                measuring = false;
+                heads = 0;
+                turn = 0;
+                nextKey = Clock::time_point::max();
+            }
+            else if (event == TerminalSnake)
+            {
+                heads ++;
+                if (restarting)
+                {
+                    // The first frame of the new round shows its snake
+                    restarts.push_back(std::chrono::duration<double, std::milli>(readTime - restartTime).count());
+                    restarting = false;
+                }
+                // Up and down turns change the column, left and right ones the row
+                bool turned = (turn % 2 == 0) ? tracker.getSnakeX() != keyX : tracker.getSnakeY() != keyY;
+                if (measuring && turned)
+                {
+                    latencies.push_back(std::chrono::duration<double, std::milli>(readTime - keyTime).count());
+                    measuring = false;
+                    turn = (turn + 1) % 4;
+                    nextKey = readTime + std::chrono::microseconds((long long)(pause(this->mRandom) * delay * 1000));
+                }
+                else if (!measuring && heads == 3)
+                {
+                    nextKey = readTime + std::chrono::microseconds((long long)(pause(this->mRandom) * delay * 1000));
+                }
+            }
+        }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    close(master);
+    return ok;
+}
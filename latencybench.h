@@ -0,0 +1,48 @@
+#ifndef LATENCYBENCH_H
+#define LATENCYBENCH_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+struct LatencyBenchParams
+{
+    // Turns measured for every terminal size and difficulty
+    int samples = 40;
+    // Rounds ended and restarted, timed from the menu's Enter to the
+    // first frame of the new round
+    int restarts = 5;
+    // Each difficulty is played at the tick interval the stepped speed
+    // curve gives it, kept constant for the whole round
+    std::vector<int> difficulties = {0, 2, 4};
+    // Columns and rows of every terminal tried
+    std::vector<int> columns = {80, 120, 200};
+    std::vector<int> rows = {24, 40, 60};
+    int baseDelay = 100;
+    unsigned int seed = 1;
+};
+
+// Measures what a player feels between pressing a key and seeing the
+// snake turn. The game runs under a pseudo-terminal exactly as it would
+// under a terminal emulator; turns are typed at random points between
+// ticks and its output is followed until the head shows up off the line
+// it was moving along.
+class LatencyBench
+{
+public:
+    explicit LatencyBench(const LatencyBenchParams& params);
+    // Prints the latency percentiles of every configuration
+    bool run();
+
+private:
+    // Plays one configuration until enough turns and restarts were seen,
+    // false if the game could not be started or stopped drawing
+    bool measure(int columns, int rows, int delay, std::vector<double>& latencies, std::vector<double>& restarts);
+
+    LatencyBenchParams mParams;
+    // Holds the rounds and saves of the measured games
+    std::string mDirectory;
+    std::mt19937 mRandom;
+};
+
+#endif
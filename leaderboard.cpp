@@ -0,0 +1,152 @@
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <vector>
+
+// For the raw reads of the log
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "leaderboard.h"
+#include "checksum.h"
+
+struct LeaderboardHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t reserved;
+    uint32_t checksum;
+};
+
+struct LeaderboardRecord
+{
+    LeaderboardEntry entry;
+    uint32_t checksum;
+    uint32_t padding;
+};
+
+static const char gLeaderboardMagic[8] = {'S', 'N', 'K', 'S', 'C', 'O', 'R', 'E'};
+static const uint32_t gLeaderboardVersion = 1;
+
+static bool isValidHeader(const LeaderboardHeader& header)
+{
+    return std::memcmp(header.magic, gLeaderboardMagic, sizeof(gLeaderboardMagic)) == 0
+        && header.version == gLeaderboardVersion
+        && header.entrySize == sizeof(LeaderboardEntry)
+        && header.checksum == crc32(&header, offsetof(LeaderboardHeader, checksum));
+}
+
+bool LeaderboardOrder::operator () (const LeaderboardEntry& a, const LeaderboardEntry& b) const
+{
+    if (a.score != b.score)
+    {
+        return a.score > b.score;
+    }
+    return a.timestamp < b.timestamp;
+}
+
+Leaderboard::Leaderboard(const std::string& path, int capacity)
+    : mPath(path), mCapacity(capacity)
+{
+}
+
+LeaderboardEntry Leaderboard::makeEntry(const std::string& name, int score, int length, unsigned int seed)
+{
+    LeaderboardEntry entry = {};
+    std::strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+    entry.score = score;
+    entry.length = length;
+    entry.seed = seed;
+    entry.timestamp = std::time(nullptr);
+    return entry;
+}
+
+bool Leaderboard::load()
+{
+    this->mEntries.clear();
+    int fd = ::open(this->mPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    LeaderboardHeader header;
+    if (::read(fd, &header, sizeof(header)) != sizeof(header) || !isValidHeader(header))
+    {
+        ::close(fd);
+        return this->loadLegacy();
+    }
+    // Read the log in blocks, a short or corrupt record ends it
+    std::vector<LeaderboardRecord> records(256);
+    bool torn = false;
+    while (!torn)
+    {
+        ssize_t bytes = ::read(fd, records.data(), records.size() * sizeof(LeaderboardRecord));
+        if (bytes <= 0)
+        {
+            break;
+        }
+        int count = bytes / sizeof(LeaderboardRecord);
+        torn = bytes % sizeof(LeaderboardRecord) != 0;
+        for (int i = 0; i < count; i ++)
+        {
+            if (records[i].checksum != crc32(&records[i].entry, sizeof(records[i].entry)))
+            {
+                torn = true;
+                break;
+            }
+            this->insert(records[i].entry);
+        }
+    }
+    ::close(fd);
+    return true;
+}
+
+bool Leaderboard::loadLegacy()
+{
+    // The old record.dat was three raw ints, carry those scores over
+    int fd = ::open(this->mPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    int scores[3];
+    struct stat info;
+    bool legacy = fstat(fd, &info) == 0 && info.st_size == sizeof(scores)
+        && ::read(fd, scores, sizeof(scores)) == sizeof(scores);
+    ::close(fd);
+    if (!legacy)
+    {
+        return false;
+    }
+    for (int i = 0; i < 3; i ++)
+    {
+        if (scores[i] > 0)
+        {
+            this->insert(makeEntry("legacy", scores[i], 0, 0));
+        }
+    }
+    return true;
+}
+
+bool Leaderboard::insert(const LeaderboardEntry& entry)
+{
+    if (static_cast<int>(this->mEntries.size()) >= this->mCapacity)
+    {
+        std::multiset<LeaderboardEntry, LeaderboardOrder>::iterator last = std::prev(this->mEntries.end());
+        if (!LeaderboardOrder()(entry, *last))
+        {
+            return false;
+        }
+        this->mEntries.erase(last);
+    }
+    this->mEntries.insert(entry);
+    return true;
+}
+
+const std::multiset<LeaderboardEntry, LeaderboardOrder>& Leaderboard::getEntries() const
+{
+    return this->mEntries;
+}
@@ -0,0 +1,54 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <cstdint>
+#include <set>
+#include <string>
+
+struct LeaderboardEntry
+{
+    char name[16];
+    int32_t score;
+    int32_t length;
+    uint32_t seed;
+    uint32_t reserved;
+    int64_t timestamp;
+};
+
+// Best score first, earlier entries win ties
+struct LeaderboardOrder
+{
+    bool operator () (const LeaderboardEntry& a, const LeaderboardEntry& b) const;
+};
+
+/*
+ * Reader of the leaderboard log games kept before the shared board:
+ *   LeaderboardHeader, checksummed
+ *   records, each a LeaderboardEntry followed by its CRC-32
+ * or of the three raw ints before that. SharedLeaderboard imports it once
+ * when it creates its file; the log itself is never written again. A
+ * torn record at the end fails its checksum and ends the log.
+ * The best entries are kept in memory in a bounded ordered set.
+ */
+class Leaderboard
+{
+public:
+    Leaderboard(const std::string& path, int capacity);
+    // Reads the top entries from the log, false when there is no valid
+    // log. The file is only read.
+    bool load();
+    // Keep the entry in memory if it makes the top, O(log capacity)
+    bool insert(const LeaderboardEntry& entry);
+    // Already in rank order, nothing to sort when rendering
+    const std::multiset<LeaderboardEntry, LeaderboardOrder>& getEntries() const;
+    static LeaderboardEntry makeEntry(const std::string& name, int score, int length, unsigned int seed);
+
+private:
+    bool loadLegacy();
+
+    const std::string mPath;
+    const int mCapacity;
+    std::multiset<LeaderboardEntry, LeaderboardOrder> mEntries;
+};
+
+#endif
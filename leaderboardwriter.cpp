@@ -0,0 +1,62 @@
+#include "leaderboardwriter.h"
+#include "metrics.h"
+
+LeaderboardWriter::LeaderboardWriter(SharedLeaderboard& board)
+    : mBoard(board), mSubmitted(0), mWritten(0), mStopping(false)
+{
+    // Started last, after every member it uses is ready
+    this->mThread = std::thread(&LeaderboardWriter::run, this);
+}
+
+LeaderboardWriter::~LeaderboardWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mStopping = true;
+    }
+    this->mWake.notify_one();
+    this->mThread.join();
+}
+
+void LeaderboardWriter::submit()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mMutex);
+        this->mSubmitted ++;
+    }
+    this->mWake.notify_one();
+}
+
+void LeaderboardWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    unsigned long long target = this->mSubmitted;
+    this->mDone.wait(lock, [this, target]() { return this->mWritten >= target; });
+}
+
+void LeaderboardWriter::run()
+{
+    std::unique_lock<std::mutex> lock(this->mMutex);
+    while (true)
+    {
+        this->mWake.wait(lock, [this]() { return this->mStopping || this->mWritten < this->mSubmitted; });
+        if (this->mWritten >= this->mSubmitted)
+        {
+            // Only reached when stopping with nothing left to write
+            break;
+        }
+        unsigned long long batchEnd = this->mSubmitted;
+        lock.unlock();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (this->mBoard.sync())
+        {
+            countMetric(MetricLeaderboardWrites);
+            observeMetric(MetricLeaderboardWriteTime, std::chrono::steady_clock::now() - start);
+        }
+
+        lock.lock();
+        this->mWritten = batchEnd;
+        this->mDone.notify_all();
+    }
+}
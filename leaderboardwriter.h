@@ -0,0 +1,39 @@
+#ifndef LEADERBOARDWRITER_H
+#define LEADERBOARDWRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "sharedleaderboard.h"
+
+// Write-behind persistence for the leaderboard. Rounds go into the shared
+// table from the game thread, where every process sees them at once; a
+// worker thread puts the table on disk, everything submitted while it
+// was busy goes out with one sync. It shares nothing with the game thread
+// but the counters. Pending syncs are done on destruction.
+class LeaderboardWriter
+{
+public:
+    explicit LeaderboardWriter(SharedLeaderboard& board);
+    ~LeaderboardWriter();
+    // Asks for the table as it is now to reach the disk
+    void submit();
+    // Blocks until everything submitted so far is on disk
+    void flush();
+
+private:
+    void run();
+
+    SharedLeaderboard& mBoard;
+    // Bumped on every submit, mWritten catches up once a sync is done
+    unsigned long long mSubmitted;
+    unsigned long long mWritten;
+    bool mStopping;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    std::thread mThread;
+};
+
+#endif
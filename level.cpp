@@ -0,0 +1,272 @@
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+// For memory mapping
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "level.h"
+#include "checksum.h"
+
+static const char gLevelPackMagic[8] = {'S', 'N', 'K', 'L', 'E', 'V', 'E', 'L'};
+static const uint32_t gLevelPackVersion = 1;
+
+static uint64_t alignTo8(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+static uint64_t layerWords(uint64_t width, uint64_t height)
+{
+    return (width * height + 63) / 64;
+}
+
+// The smallest board with a free cell inside its walls for the food to
+// land on, the playable area is x in [2, width - 2] and y in [1, height - 2]
+static const uint32_t gMinLevelWidth = 5;
+static const uint32_t gMinLevelHeight = 4;
+
+static bool isInsideWalls(uint64_t cell, uint64_t width, uint64_t height)
+{
+    uint64_t x = cell % width;
+    uint64_t y = cell / width;
+    return cell < width * height && x >= 2 && x <= width - 2 && y >= 1 && y <= height - 2;
+}
+
+LevelPack::LevelPack(): mData(nullptr), mSize(0), mChecksum(0)
+{
+}
+
+LevelPack::~LevelPack()
+{
+    this->close();
+}
+
+bool LevelPack::open(const std::string& path)
+{
+    this->close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(LevelPackHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    this->mData = static_cast<const unsigned char*>(data);
+    this->mSize = info.st_size;
+
+    const LevelPackHeader* header = reinterpret_cast<const LevelPackHeader*>(this->mData);
+    uint64_t indexEnd = sizeof(LevelPackHeader) + uint64_t(header->levelCount) * sizeof(LevelIndexEntry);
+    if (std::memcmp(header->magic, gLevelPackMagic, sizeof(gLevelPackMagic)) != 0
+        || header->version != gLevelPackVersion
+        || indexEnd > this->mSize)
+    {
+        this->close();
+        return false;
+    }
+    this->mChecksum = crc32(this->mData, this->mSize);
+    return true;
+}
+
+void LevelPack::close()
+{
+    if (this->mData != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(this->mData), this->mSize);
+    }
+    this->mData = nullptr;
+    this->mSize = 0;
+    this->mChecksum = 0;
+}
+
+bool LevelPack::isOpen() const
+{
+    return this->mData != nullptr;
+}
+
+uint32_t LevelPack::getChecksum() const
+{
+    return this->mChecksum;
+}
+
+int LevelPack::getLevelCount() const
+{
+    if (!this->isOpen())
+    {
+        return 0;
+    }
+    return reinterpret_cast<const LevelPackHeader*>(this->mData)->levelCount;
+}
+
+bool LevelPack::getLevel(int index, Level& level) const
+{
+    if (index < 0 || index >= this->getLevelCount())
+    {
+        return false;
+    }
+    const LevelIndexEntry* entries = reinterpret_cast<const LevelIndexEntry*>(this->mData + sizeof(LevelPackHeader));
+    const LevelIndexEntry& entry = entries[index];
+    if (entry.offset % 8 != 0 || entry.size < sizeof(LevelHeader)
+        || entry.offset > this->mSize || entry.size > this->mSize - entry.offset)
+    {
+        return false;
+    }
+    const unsigned char* base = this->mData + entry.offset;
+    const LevelHeader* header = reinterpret_cast<const LevelHeader*>(base);
+    uint64_t layerBytes = layerWords(header->width, header->height) * sizeof(uint64_t);
+    uint64_t spawnBytes = uint64_t(header->spawnCount) * sizeof(uint32_t);
+    if (header->width < gMinLevelWidth || header->height < gMinLevelHeight
+        || header->width > UINT32_MAX / header->height
+        || header->obstacleOffset % 8 != 0 || header->powerPathOffset % 8 != 0 || header->spawnOffset % 4 != 0
+        || header->obstacleOffset + layerBytes > entry.size
+        || header->powerPathOffset + layerBytes > entry.size
+        || header->spawnOffset + spawnBytes > entry.size)
+    {
+        return false;
+    }
+    // A snake spawned into a wall or an obstacle dies on its first tick
+    const uint64_t* obstacleBits = reinterpret_cast<const uint64_t*>(base + header->obstacleOffset);
+    const uint32_t* spawnPoints = reinterpret_cast<const uint32_t*>(base + header->spawnOffset);
+    for (uint32_t i = 0; i < header->spawnCount; i ++)
+    {
+        uint32_t cell = spawnPoints[i];
+        if (!isInsideWalls(cell, header->width, header->height) || (obstacleBits[cell / 64] >> (cell % 64)) & 1)
+        {
+            return false;
+        }
+    }
+
+    level.width = header->width;
+    level.height = header->height;
+    level.obstacleBits = obstacleBits;
+    level.powerPathBits = reinterpret_cast<const uint64_t*>(base + header->powerPathOffset);
+    level.spawnPoints = spawnPoints;
+    level.spawnCount = header->spawnCount;
+    return true;
+}
+
+// Reads one ASCII level and appends its encoded form to the pack buffer
+static bool appendAsciiLevel(const std::string& inputPath, std::vector<unsigned char>& pack)
+{
+    std::ifstream fhand(inputPath);
+    if (!fhand.is_open())
+    {
+        return false;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    std::size_t width = 0;
+    while (std::getline(fhand, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        width = std::max(width, line.size());
+        lines.push_back(line);
+    }
+    std::size_t height = lines.size();
+    if (width < gMinLevelWidth || height < gMinLevelHeight || width > UINT32_MAX / height)
+    {
+        return false;
+    }
+
+    uint64_t words = layerWords(width, height);
+    std::vector<uint64_t> obstacleBits(words, 0);
+    std::vector<uint64_t> powerPathBits(words, 0);
+    std::vector<uint32_t> spawnPoints;
+    for (std::size_t y = 0; y < height; y ++)
+    {
+        for (std::size_t x = 0; x < lines[y].size(); x ++)
+        {
+            uint64_t cell = y * width + x;
+            switch (lines[y][x])
+            {
+                case '!':
+                    obstacleBits[cell / 64] |= uint64_t(1) << (cell % 64);
+                    break;
+                case '*':
+                    powerPathBits[cell / 64] |= uint64_t(1) << (cell % 64);
+                    break;
+                case '@':
+                    // Packs that could not be loaded are never written
+                    if (!isInsideWalls(cell, width, height))
+                    {
+                        return false;
+                    }
+                    spawnPoints.push_back(cell);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    LevelHeader header = {};
+    header.width = width;
+    header.height = height;
+    header.spawnCount = spawnPoints.size();
+    header.obstacleOffset = alignTo8(sizeof(LevelHeader));
+    header.powerPathOffset = header.obstacleOffset + words * sizeof(uint64_t);
+    header.spawnOffset = header.powerPathOffset + words * sizeof(uint64_t);
+    uint64_t size = alignTo8(header.spawnOffset + spawnPoints.size() * sizeof(uint32_t));
+
+    std::size_t start = pack.size();
+    pack.resize(start + size, 0);
+    unsigned char* base = pack.data() + start;
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base + header.obstacleOffset, obstacleBits.data(), words * sizeof(uint64_t));
+    std::memcpy(base + header.powerPathOffset, powerPathBits.data(), words * sizeof(uint64_t));
+    if (!spawnPoints.empty())
+    {
+        std::memcpy(base + header.spawnOffset, spawnPoints.data(), spawnPoints.size() * sizeof(uint32_t));
+    }
+    return true;
+}
+
+bool convertAsciiLevels(const std::vector<std::string>& inputPaths, const std::string& outputPath)
+{
+    LevelPackHeader packHeader = {};
+    std::memcpy(packHeader.magic, gLevelPackMagic, sizeof(gLevelPackMagic));
+    packHeader.version = gLevelPackVersion;
+    packHeader.levelCount = inputPaths.size();
+
+    // Header and index first, the level offsets are patched in as they are appended
+    uint64_t indexSize = inputPaths.size() * sizeof(LevelIndexEntry);
+    std::vector<unsigned char> pack(alignTo8(sizeof(LevelPackHeader) + indexSize), 0);
+    std::memcpy(pack.data(), &packHeader, sizeof(packHeader));
+    for (std::size_t i = 0; i < inputPaths.size(); i ++)
+    {
+        LevelIndexEntry entry;
+        entry.offset = pack.size();
+        if (!appendAsciiLevel(inputPaths[i], pack))
+        {
+            return false;
+        }
+        entry.size = pack.size() - entry.offset;
+        std::memcpy(pack.data() + sizeof(LevelPackHeader) + i * sizeof(LevelIndexEntry), &entry, sizeof(entry));
+    }
+
+    std::fstream fhand(outputPath, fhand.binary | fhand.trunc | fhand.out);
+    if (!fhand.is_open())
+    {
+        return false;
+    }
+    fhand.write(reinterpret_cast<const char*>(pack.data()), pack.size());
+    fhand.close();
+    return !fhand.fail();
+}
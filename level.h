@@ -0,0 +1,90 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Binary level pack, memory mapped read-only by LevelPack.
+ * A single level file is simply a pack holding one level.
+ *
+ * Layout, every section 8-byte aligned:
+ *   LevelPackHeader
+ *   LevelIndexEntry[levelCount]   where each level starts in the file
+ *   for every level:
+ *     LevelHeader
+ *     obstacle layer    ceil(width * height / 64) uint64 words, row-major,
+ *                       bit (y * width + x) set means an obstacle
+ *     power-path layer  same layout as the obstacle layer
+ *     spawn points      spawnCount uint32 cell indices (y * width + x)
+ *
+ * Both layers are bitmaps rather than RLE so a cell is one lookup
+ * straight into the mapping, with nothing decoded at load time.
+ */
+
+struct LevelPackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t levelCount;
+};
+
+struct LevelIndexEntry
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct LevelHeader
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t spawnCount;
+    uint32_t reserved;
+    // Offsets of the layers relative to the start of the LevelHeader
+    uint64_t obstacleOffset;
+    uint64_t powerPathOffset;
+    uint64_t spawnOffset;
+};
+
+// A view into a mapped level, valid as long as its LevelPack is open
+struct Level
+{
+    int width = 0;
+    int height = 0;
+    const uint64_t* obstacleBits = nullptr;
+    const uint64_t* powerPathBits = nullptr;
+    const uint32_t* spawnPoints = nullptr;
+    int spawnCount = 0;
+};
+
+class LevelPack
+{
+public:
+    LevelPack();
+    ~LevelPack();
+    LevelPack(const LevelPack&) = delete;
+    LevelPack& operator = (const LevelPack&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    int getLevelCount() const;
+    bool getLevel(int index, Level& level) const;
+    // CRC-32 of the whole pack, tells a snapshot which pack it was saved on
+    uint32_t getChecksum() const;
+
+private:
+    const unsigned char* mData;
+    std::size_t mSize;
+    uint32_t mChecksum;
+};
+
+// Convert plain-text levels into one pack, one input file per level.
+// '!' marks an obstacle, '*' a power path, '@' a spawn point,
+// anything else is an empty cell. The widest line sets the width.
+bool convertAsciiLevels(const std::vector<std::string>& inputPaths, const std::string& outputPath);
+
+#endif
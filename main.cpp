@@ -1,7 +1,325 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "game.h"
+#include "level.h"
+#include "selfcheck.h"
+#include "trainer.h"
+#include "latencybench.h"
+#include "soak.h"
+#include "framebench.h"
+#include "metricsexporter.h"
+#include "engine.h"
+#include "observation.h"
+
+// Plays rounds headless, each step waits for the external trainer's action
+static int runObservationExport(const std::string& name, int width, int height)
+{
+    MapGenParams params;
+    Engine engine(width, height, params, 2);
+    ObservationExporter exporter;
+    if (!exporter.open(name, width, height, 64))
+    {
+        std::cerr << "Failed to open shared memory " << name << std::endl;
+        return 1;
+    }
+    exporter.serve(engine, std::time(nullptr));
+    return 0;
+}
+
+// True when argv[i] exists and is a value rather than the next option
+static bool hasValue(int argc, char** argv, int i)
+{
+    return i < argc && std::strncmp(argv[i], "--", 2) != 0;
+}
 
 int main(int argc, char** argv)
 {
-    Game game;
-    game.startGame();
+    // snake --convert-level out.lvl level1.txt [level2.txt ...]
+    if (argc >= 4 && std::strcmp(argv[1], "--convert-level") == 0)
+    {
+        std::vector<std::string> inputPaths(argv + 3, argv + argc);
+        if (!convertAsciiLevels(inputPaths, argv[2]))
+        {
+            std::cerr << "Failed to convert levels into " << argv[2] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    // snake --train generations out.genome [population]
+    if (argc >= 4 && std::strcmp(argv[1], "--train") == 0)
+    {
+        TrainerParams params;
+        params.seed = std::time(nullptr);
+        if (argc >= 5)
+        {
+            params.populationSize = std::max(2, std::atoi(argv[4]));
+        }
+        Trainer trainer(params);
+        return trainer.run(std::atoi(argv[2]), argv[3]) ? 0 : 1;
+    }
+
+    // snake --observe shm-name [width height]
+    if (argc >= 3 && std::strcmp(argv[1], "--observe") == 0)
+    {
+        int width = argc >= 5 ? std::atoi(argv[3]) : 40;
+        int height = argc >= 5 ? std::atoi(argv[4]) : 20;
+        return runObservationExport(argv[2], std::max(16, width), std::max(16, height));
+    }
+
+    // snake --soak report.csv [minutes [seed]]
+    if (argc >= 3 && std::strcmp(argv[1], "--soak") == 0)
+    {
+        SoakParams params;
+        params.seed = argc >= 5 ? std::strtoul(argv[4], nullptr, 10) : std::time(nullptr);
+        if (argc >= 4)
+        {
+            params.minutes = std::atof(argv[3]);
+        }
+        SoakTest soak(params);
+        return soak.run(argv[2]) ? 0 : 1;
+    }
+
+    // snake --check-allocations [ticks], in a build with -DSNAKE_COUNT_ALLOCATIONS
+    if (argc >= 2 && std::strcmp(argv[1], "--check-allocations") == 0)
+    {
+        long long ticks = argc >= 3 ? std::max(1LL, std::atoll(argv[2])) : 1000000;
+        return checkTickAllocations(ticks) ? 0 : 1;
+    }
+
+    // snake --check-reachability [ticks]
+    if (argc >= 2 && std::strcmp(argv[1], "--check-reachability") == 0)
+    {
+        long long ticks = argc >= 3 ? std::max(1LL, std::atoll(argv[2])) : 100000;
+        return checkReachability(ticks, std::time(nullptr)) ? 0 : 1;
+    }
+
+    // snake --check-observation [steps]
+    if (argc >= 2 && std::strcmp(argv[1], "--check-observation") == 0)
+    {
+        long long steps = argc >= 3 ? std::max(1LL, std::atoll(argv[2])) : 100000;
+        return checkObservationRoundTrip(steps) ? 0 : 1;
+    }
+
+    // snake --check-world [width height [ticks]]
+    if (argc >= 2 && std::strcmp(argv[1], "--check-world") == 0)
+    {
+        int width = argc >= 4 ? std::atoi(argv[2]) : 100000;
+        int height = argc >= 4 ? std::atoi(argv[3]) : 100000;
+        long long ticks = argc >= 5 ? std::max(1LL, std::atoll(argv[4])) : 10000;
+        return checkWorld(width, height, ticks, std::time(nullptr)) ? 0 : 1;
+    }
+
+    // snake --check-shared-leaderboard [processes [rounds]]
+    if (argc >= 2 && std::strcmp(argv[1], "--check-shared-leaderboard") == 0)
+    {
+        int processes = argc >= 3 ? std::max(2, std::atoi(argv[2])) : 8;
+        int rounds = argc >= 4 ? std::max(1, std::atoi(argv[3])) : 20;
+        return checkSharedLeaderboard(processes, rounds, std::time(nullptr)) ? 0 : 1;
+    }
+
+    // snake --bench-latency [samples]
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-latency") == 0)
+    {
+        LatencyBenchParams params;
+        if (argc >= 3)
+        {
+            params.samples = std::max(1, std::atoi(argv[2]));
+        }
+        LatencyBench bench(params);
+        return bench.run() ? 0 : 1;
+    }
+
+    // snake --bench-frames [frames]
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-frames") == 0)
+    {
+        FrameBenchParams params;
+        if (argc >= 3)
+        {
+            params.frames = std::max(1, std::atoi(argv[2]));
+        }
+        FrameBench bench(params);
+        return bench.run() ? 0 : 1;
+    }
+
+    std::string levelPath;
+    std::string autopilotPath;
+    int levelIndex = 0;
+    int worldWidth = 0;
+    int worldHeight = 0;
+    unsigned int worldSeed = std::time(nullptr);
+    double obstacleDensity = -1;
+    int movingObstacleNum = -1;
+    bool dangerOverlay = false;
+    int baseDelay = 0;
+    std::string snapshotPath = "snapshot.dat";
+    bool resume = false;
+    std::string metricsTarget;
+    int metricsInterval = 10;
+    RuleParams rules;
+    for (int i = 1; i < argc; i ++)
+    {
+        // --level pack.lvl [index]
+        if (std::strcmp(argv[i], "--level") == 0 && hasValue(argc, argv, i + 1))
+        {
+            levelPath = argv[++ i];
+            if (hasValue(argc, argv, i + 1))
+            {
+                levelIndex = std::atoi(argv[++ i]);
+            }
+        }
+        // --world width height [seed]
+        else if (std::strcmp(argv[i], "--world") == 0 && hasValue(argc, argv, i + 2))
+        {
+            worldWidth = std::atoi(argv[++ i]);
+            worldHeight = std::atoi(argv[++ i]);
+            if (hasValue(argc, argv, i + 1))
+            {
+                worldSeed = std::strtoul(argv[++ i], nullptr, 10);
+            }
+        }
+        // --density share of the generated board covered by walls
+        else if (std::strcmp(argv[i], "--density") == 0 && hasValue(argc, argv, i + 1))
+        {
+            obstacleDensity = std::atof(argv[++ i]);
+        }
+        // --moving number of obstacles that patrol on their own
+        else if (std::strcmp(argv[i], "--moving") == 0 && hasValue(argc, argv, i + 1))
+        {
+            movingObstacleNum = std::atoi(argv[++ i]);
+        }
+        // --danger marks moves into pockets smaller than the snake
+        else if (std::strcmp(argv[i], "--danger") == 0)
+        {
+            dangerOverlay = true;
+        }
+        // --wrap leaves the board on one side and enters it on the other
+        else if (std::strcmp(argv[i], "--wrap") == 0)
+        {
+            rules.walls = WallRule::Wrap;
+        }
+        // --fatal-obstacles takes away the survive key
+        else if (std::strcmp(argv[i], "--fatal-obstacles") == 0)
+        {
+            rules.obstacles = ObstacleRule::Fatal;
+        }
+        // --growth segments added per food
+        else if (std::strcmp(argv[i], "--growth") == 0 && hasValue(argc, argv, i + 1))
+        {
+            rules.growth = std::atoi(argv[++ i]);
+        }
+        // --constant-speed keeps the first interval all round
+        else if (std::strcmp(argv[i], "--constant-speed") == 0)
+        {
+            rules.speed = SpeedRule::Constant;
+        }
+        // --delay first tick interval in milliseconds
+        else if (std::strcmp(argv[i], "--delay") == 0 && hasValue(argc, argv, i + 1))
+        {
+            baseDelay = std::atoi(argv[++ i]);
+        }
+        // --autopilot genome written by --train
+        else if (std::strcmp(argv[i], "--autopilot") == 0 && hasValue(argc, argv, i + 1))
+        {
+            autopilotPath = argv[++ i];
+        }
+        // --snapshot file the save key, SIGTERM and SIGTSTP save the round to
+        else if (std::strcmp(argv[i], "--snapshot") == 0 && hasValue(argc, argv, i + 1))
+        {
+            snapshotPath = argv[++ i];
+        }
+        // --resume continues the round saved in the snapshot file
+        else if (std::strcmp(argv[i], "--resume") == 0)
+        {
+            resume = true;
+        }
+        // --metrics tcp:port, unix:path or a file to append to
+        else if (std::strcmp(argv[i], "--metrics") == 0 && hasValue(argc, argv, i + 1))
+        {
+            metricsTarget = argv[++ i];
+        }
+        // --metrics-interval seconds between appends to a metrics file
+        else if (std::strcmp(argv[i], "--metrics-interval") == 0 && hasValue(argc, argv, i + 1))
+        {
+            metricsInterval = std::atoi(argv[++ i]);
+        }
+        else
+        {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    // Opened before curses takes the terminal, so a failure can be reported
+    MetricsExporter metrics;
+    if (!metricsTarget.empty() && !metrics.start(metricsTarget, metricsInterval))
+    {
+        std::cerr << "Failed to export metrics to " << metricsTarget << std::endl;
+        return 1;
+    }
+    bool levelLoaded = true;
+    bool autopilotLoaded = true;
+    bool resumeFailed = false;
+    bool inputLost = false;
+    {
+        Game game;
+        if (!levelPath.empty())
+        {
+            levelLoaded = game.loadLevelPack(levelPath, levelIndex);
+        }
+        if (worldWidth > 0 && worldHeight > 0)
+        {
+            game.useWorld(worldWidth, worldHeight, worldSeed);
+        }
+        if (obstacleDensity >= 0)
+        {
+            game.getMapGenParams().obstacleDensity = obstacleDensity;
+        }
+        if (movingObstacleNum >= 0)
+        {
+            game.getMapGenParams().movingObstacleNum = movingObstacleNum;
+        }
+        game.setDangerOverlay(dangerOverlay);
+        game.getRules() = rules;
+        if (baseDelay > 0)
+        {
+            game.setBaseDelay(baseDelay);
+        }
+        game.setSnapshot(snapshotPath, resume);
+        if (!autopilotPath.empty())
+        {
+            autopilotLoaded = game.loadAutopilot(autopilotPath);
+        }
+        if (levelLoaded && autopilotLoaded)
+        {
+            inputLost = !game.startGame();
+        }
+        resumeFailed = game.hasResumeFailed();
+    }
+    // Reported once curses has released the terminal
+    if (!levelLoaded)
+    {
+        std::cerr << "Failed to load level " << levelIndex << " from " << levelPath << std::endl;
+        return 1;
+    }
+    if (!autopilotLoaded)
+    {
+        std::cerr << "Failed to load autopilot from " << autopilotPath << std::endl;
+        return 1;
+    }
+    if (inputLost)
+    {
+        std::cerr << "Lost the terminal input, the game was ended" << std::endl;
+        return 1;
+    }
+    if (resumeFailed)
+    {
+        std::cerr << "Could not resume from " << snapshotPath << ", a new round was played instead" << std::endl;
+    }
+    return 0;
 }
@@ -1,6 +1,7 @@
 #include <string>
 #include <cstdlib>
 #include <vector>
+#include <algorithm>
 
 #include <iostream>
 #include "map.h"
@@ -8,47 +9,726 @@
 using namespace std;
 
 
-Map::Map(int gameBoardWidth, int gameBoardHeight, int initialObstacleNum, int initialPowerPathLength)
-        : mGameBoardWidth(gameBoardWidth), mGameBoardHeight(gameBoardHeight), mInitialObstacleNum(initialObstacleNum), mInitialPowerPathLength(initialPowerPathLength)
+Map::Map(int gameBoardWidth, int gameBoardHeight, const MapGenParams& params, unsigned int seed)
+        : mObstacleBits(nullptr), mPowerPathBits(nullptr), mSpawnPoints(nullptr), mSpawnPointNum(0), mHasLevel(false), mParams(params), mSeed(seed), mObstacleNum(0),
+          mGameBoardWidth(gameBoardWidth), mGameBoardHeight(gameBoardHeight)
 {
+    this->powerPath.reserve(this->mParams.powerPathNum * this->mParams.powerPathLength);
     this->initializeMap();
 }
 
 
 void Map::initializeMap()
 {
-    int centerX = this->mGameBoardWidth/2 - this->mInitialObstacleNum/2;
+    // A loaded level is immutable, only the snake's marks are reset
+    if (this->mHasLevel)
+    {
+        this->mSnakeBits.assign(((size_t)this->mGameBoardWidth * this->mGameBoardHeight + 63) / 64, 0);
+        return;
+    }
+    // A world forgets the chunks of the last round, the memory is kept for reuse
+    if (this->mWorld.isActive())
+    {
+        this->mWorld.reset(this->mGameBoardWidth, this->mGameBoardHeight,
+            [this](int chunkX, int chunkY, unsigned char* cells) { this->generateWorldChunk(chunkX, chunkY, cells); });
+        // Movers only patrol the neighbourhood of the spawn point
+        std::mt19937 random(this->mSeed);
+        int centerX = this->mGameBoardWidth / 2;
+        int centerY = this->mGameBoardHeight / 2;
+        this->spawnMovingObstacles(random, std::max(2, centerX - 256), std::min(this->mGameBoardWidth - 2, centerX + 256),
+            std::max(1, centerY - 256), std::min(this->mGameBoardHeight - 2, centerY + 256));
+        return;
+    }
+    this->generate();
+}
+
+void Map::setSeed(unsigned int seed)
+{
+    this->mSeed = seed;
+}
+
+unsigned int Map::getSeed() const
+{
+    return this->mSeed;
+}
+
+bool Map::isSpawnZone(int x, int y) const
+{
+    // The column the snake starts in and heads up from
+    int centerX = this->mGameBoardWidth / 2;
     int centerY = this->mGameBoardHeight / 2;
+    return std::abs(x - centerX) <= 2 && y >= centerY - 10 && y <= centerY + 3;
+}
+
+// Union-find root with path halving
+static int findRoot(std::vector<int>& parent, int cell)
+{
+    while (parent[cell] != cell)
+    {
+        parent[cell] = parent[parent[cell]];
+        cell = parent[cell];
+    }
+    return cell;
+}
+
+void Map::generate()
+{
+    int width = this->mGameBoardWidth;
+    int height = this->mGameBoardHeight;
+    size_t cells = (size_t)width * height;
+    // assign() reuses the capacity unless the board grew
+    this->mOwnedObstacleBits.assign((cells + 63) / 64, 0);
+    this->mOwnedPowerPathBits.assign((cells + 63) / 64, 0);
+    this->mSnakeBits.assign((cells + 63) / 64, 0);
+    this->mObstacleBits = this->mOwnedObstacleBits.data();
+    this->mPowerPathBits = this->mOwnedPowerPathBits.data();
+    this->mObstacleNum = -1;
+    this->powerPath.clear();
+    // The snake dies at x <= 1, x >= width - 1, y <= 0 and y >= height - 1
+    int minX = 2, maxX = width - 2, minY = 1, maxY = height - 2;
+    if (maxX < minX || maxY < minY)
+    {
+        return;
+    }
+    std::mt19937 random(this->mSeed);
+    uint64_t* obstacleBits = this->mOwnedObstacleBits.data();
+
+    // Scatter straight walls
+    int interiorWidth = maxX - minX + 1;
+    int interiorHeight = maxY - minY + 1;
+    int maxWallLength = std::max(1, this->mParams.maxWallLength);
+    long long wallNum = this->mParams.obstacleDensity * interiorWidth * interiorHeight / ((maxWallLength + 1) / 2.0);
+    for (long long i = 0; i < wallNum; i ++)
+    {
+        int x = random() % interiorWidth + minX;
+        int y = random() % interiorHeight + minY;
+        bool horizontal = random() & 1;
+        int length = random() % maxWallLength + 1;
+        for (int j = 0; j < length && x <= maxX && y <= maxY; j ++)
+        {
+            if (!this->isSpawnZone(x, y))
+            {
+                size_t cell = (size_t)y * width + x;
+                obstacleBits[cell / 64] |= uint64_t(1) << (cell % 64);
+            }
+            if (horizontal)
+                x ++;
+            else
+                y ++;
+        }
+    }
+
+    // Union-find over runs of free cells instead of single cells: every
+    // run joins the runs it touches in the row above, one pass labels all
+    // connected regions and the work follows the number of walls rather
+    // than the number of cells
+    std::vector<int>& parent = this->mGenParent;
+    std::vector<int>& runStart = this->mGenRunStart;
+    std::vector<int>& runEnd = this->mGenRunEnd;
+    std::vector<int>& runRow = this->mGenRunRow;
+    parent.clear();
+    runStart.clear();
+    runEnd.clear();
+    runRow.clear();
+    int spawnX = width / 2;
+    int spawnY = height / 2;
+    int spawnRun = -1;
+    int previousFirst = 0, previousLast = 0;
+    for (int y = minY; y <= maxY; y ++)
+    {
+        int first = runStart.size();
+        size_t rowCell = (size_t)y * width;
+        int x = minX;
+        while (x <= maxX)
+        {
+            size_t cell = rowCell + x;
+            if ((obstacleBits[cell / 64] >> (cell % 64)) & 1)
+            {
+                x ++;
+                continue;
+            }
+            int start = x;
+            while (x <= maxX && !((obstacleBits[(rowCell + x) / 64] >> ((rowCell + x) % 64)) & 1))
+            {
+                x ++;
+            }
+            int run = runStart.size();
+            runStart.push_back(start);
+            runEnd.push_back(x - 1);
+            runRow.push_back(y);
+            parent.push_back(run);
+            if (y == spawnY && start <= spawnX && spawnX <= x - 1)
+            {
+                spawnRun = run;
+            }
+        }
+        int last = runStart.size();
+        // Runs of both rows are sorted, walk them together to find overlaps
+        int above = previousFirst;
+        for (int run = first; run < last && above < previousLast; run ++)
+        {
+            while (above < previousLast && runEnd[above] < runStart[run])
+            {
+                above ++;
+            }
+            while (above < previousLast && runStart[above] <= runEnd[run])
+            {
+                int rootAbove = findRoot(parent, above);
+                int root = findRoot(parent, run);
+                if (rootAbove != root)
+                {
+                    parent[std::max(rootAbove, root)] = std::min(rootAbove, root);
+                }
+                if (runEnd[above] > runEnd[run])
+                {
+                    break;
+                }
+                above ++;
+            }
+        }
+        previousFirst = first;
+        previousLast = last;
+    }
+
+    // Fill every region the spawn point cannot reach
+    int spawnRoot = spawnRun >= 0 ? findRoot(parent, spawnRun) : -1;
+    for (int run = 0; run < runStart.size(); run ++)
+    {
+        if (findRoot(parent, run) == spawnRoot)
+        {
+            continue;
+        }
+        size_t rowCell = (size_t)runRow[run] * width;
+        for (int x = runStart[run]; x <= runEnd[run]; x ++)
+        {
+            size_t cell = rowCell + x;
+            obstacleBits[cell / 64] |= uint64_t(1) << (cell % 64);
+        }
+    }
+
+    this->generatePowerPaths(random);
+    this->spawnMovingObstacles(random, minX, maxX, minY, maxY);
+}
+
+void Map::spawnMovingObstacles(std::mt19937& random, int minX, int maxX, int minY, int maxY)
+{
+    this->mMovers.clear();
+    int period = std::max(1, this->mParams.movingObstaclePeriod);
+    // clear() on the buckets keeps their storage for the next round
+    this->mMoverBuckets.resize(period);
+    for (int i = 0; i < period; i ++)
+    {
+        this->mMoverBuckets[i].clear();
+    }
+    this->mMovedFrom.clear();
+    this->mMovedTo.clear();
+    if (maxX < minX || maxY < minY || this->mParams.movingObstacleNum <= 0)
+    {
+        return;
+    }
+    this->mMovers.reserve(this->mParams.movingObstacleNum);
+    this->mMovedFrom.reserve(this->mParams.movingObstacleNum);
+    this->mMovedTo.reserve(this->mParams.movingObstacleNum);
+    for (int i = 0; i < this->mParams.movingObstacleNum; i ++)
+    {
+        int x = random() % (maxX - minX + 1) + minX;
+        int y = random() % (maxY - minY + 1) + minY;
+        if (this->isObstacle(x, y) || this->isPowerPath(x, y) || this->isSpawnZone(x, y))
+        {
+            continue;
+        }
+        MovingObstacle mover;
+        mover.x = x;
+        mover.y = y;
+        mover.direction = random() % 4;
+        mover.step = 0;
+        mover.length = std::max(1, this->mParams.patrolLength);
+        mover.loop = random() & 1;
+        this->setObstacleCell(x, y, true);
+        // Spread the movers over the buckets so every tick moves about the same number
+        this->mMoverBuckets[this->mMovers.size() % period].push_back(this->mMovers.size());
+        this->mMovers.push_back(mover);
+    }
+}
+
+void Map::moveObstacles(long long tick, const std::function<bool(int, int)>& isBlocked)
+{
+    this->mMovedFrom.clear();
+    this->mMovedTo.clear();
+    if (this->mMovers.empty())
+    {
+        return;
+    }
+    const int dx[] = {0, 1, 0, -1};
+    const int dy[] = {-1, 0, 1, 0};
+    std::vector<int>& due = this->mMoverBuckets[tick % this->mMoverBuckets.size()];
+    for (int i = 0; i < due.size(); i ++)
+    {
+        MovingObstacle& mover = this->mMovers[due[i]];
+        if (mover.step >= mover.length)
+        {
+            mover.direction = mover.loop ? (mover.direction + 1) % 4 : (mover.direction + 2) % 4;
+            mover.step = 0;
+        }
+        int x = mover.x + dx[mover.direction];
+        int y = mover.y + dy[mover.direction];
+        if (x < 2 || x > this->mGameBoardWidth - 2 || y < 1 || y > this->mGameBoardHeight - 2
+            || this->isObstacle(x, y) || this->isPowerPath(x, y) || isBlocked(x, y))
+        {
+            // Turn early and try again on the next due tick
+            mover.step = mover.length;
+            continue;
+        }
+        this->setObstacleCell(mover.x, mover.y, false);
+        this->setObstacleCell(x, y, true);
+        this->mMovedFrom.push_back(SnakeBody(mover.x, mover.y));
+        this->mMovedTo.push_back(SnakeBody(x, y));
+        mover.x = x;
+        mover.y = y;
+        mover.step ++;
+    }
+}
+
+const vector<SnakeBody>& Map::getMovedFrom() const
+{
+    return this->mMovedFrom;
+}
+
+const vector<SnakeBody>& Map::getMovedTo() const
+{
+    return this->mMovedTo;
+}
+
+int Map::getMovingObstacleNum() const
+{
+    return this->mMovers.size();
+}
+
+const vector<MovingObstacle>& Map::getMovers() const
+{
+    return this->mMovers;
+}
+
+std::size_t Map::getMemoryUsage() const
+{
+    std::size_t usage = (this->mOwnedObstacleBits.capacity() + this->mOwnedPowerPathBits.capacity()
+        + this->mSnakeBits.capacity() + this->mScratchBits.capacity()) * sizeof(uint64_t)
+        + (this->mGenParent.capacity() + this->mGenRunStart.capacity() + this->mGenRunEnd.capacity()
+        + this->mGenRunRow.capacity()) * sizeof(int)
+        + (this->powerPath.capacity() + this->mMovedFrom.capacity() + this->mMovedTo.capacity()) * sizeof(SnakeBody)
+        + this->mMovers.capacity() * sizeof(MovingObstacle)
+        + this->mMoverBuckets.capacity() * sizeof(vector<int>);
+    for (int i = 0; i < this->mMoverBuckets.size(); i ++)
+    {
+        usage += this->mMoverBuckets[i].capacity() * sizeof(int);
+    }
+    return usage + this->mWorld.getMemoryUsage();
+}
+
+const uint64_t* Map::getObstacleBits() const
+{
+    return this->hasFixedBounds() ? nullptr : this->mOwnedObstacleBits.data();
+}
+
+bool Map::restoreBoard(int width, int height, unsigned int seed, const uint64_t* obstacleBits,
+    const vector<MovingObstacle>& movers)
+{
+    if (this->mHasLevel)
+    {
+        if (width != this->mGameBoardWidth || height != this->mGameBoardHeight || !movers.empty())
+        {
+            return false;
+        }
+        this->initializeMap();
+        return true;
+    }
+    if (this->mWorld.isActive())
+    {
+        this->initializeWorld(width, height, seed);
+        this->initializeMap();
+        // The movers spawned from the seed make way for the saved ones
+        for (int i = 0; i < this->mMovers.size(); i ++)
+        {
+            this->setObstacleCell(this->mMovers[i].x, this->mMovers[i].y, false);
+        }
+        for (int i = 0; i < movers.size(); i ++)
+        {
+            this->setObstacleCell(movers[i].x, movers[i].y, true);
+        }
+    }
+    else
+    {
+        if (obstacleBits == nullptr)
+        {
+            return false;
+        }
+        this->mGameBoardWidth = width;
+        this->mGameBoardHeight = height;
+        this->mSeed = seed;
+        size_t words = ((size_t)width * height + 63) / 64;
+        this->mOwnedObstacleBits.assign(obstacleBits, obstacleBits + words);
+        this->mOwnedPowerPathBits.assign(words, 0);
+        this->mSnakeBits.assign(words, 0);
+        this->mObstacleBits = this->mOwnedObstacleBits.data();
+        this->mPowerPathBits = this->mOwnedPowerPathBits.data();
+        this->mObstacleNum = -1;
+    }
+    // The power path is set again by its owner
+    this->powerPath.clear();
+    this->mMovers = movers;
+    // Bucketed by index exactly as spawnMovingObstacles did
+    int period = std::max(1, this->mParams.movingObstaclePeriod);
+    this->mMoverBuckets.resize(period);
+    for (int i = 0; i < period; i ++)
+    {
+        this->mMoverBuckets[i].clear();
+    }
+    for (int i = 0; i < this->mMovers.size(); i ++)
+    {
+        this->mMoverBuckets[i % period].push_back(i);
+    }
+    this->mMovedFrom.clear();
+    this->mMovedTo.clear();
+    return true;
+}
+
+void Map::generatePowerPaths(std::mt19937& random)
+{
+    // Random walks over free cells, so the paths stay reachable too
+    int width = this->mGameBoardWidth;
+    int height = this->mGameBoardHeight;
+    const int dx[] = {0, 0, -1, 1};
+    const int dy[] = {-1, 1, 0, 0};
+    for (int i = 0; i < this->mParams.powerPathNum; i ++)
+    {
+        int x = 0, y = 0;
+        bool found = false;
+        for (int attempt = 0; attempt < 100 && !found; attempt ++)
+        {
+            x = random() % (width - 3) + 2;
+            y = random() % (height - 2) + 1;
+            found = !this->isObstacle(x, y) && !this->isSpawnZone(x, y);
+        }
+        if (!found)
+        {
+            continue;
+        }
+        for (int j = 0; j < this->mParams.powerPathLength; j ++)
+        {
+            if (!this->isPowerPath(x, y))
+            {
+                this->setPowerPathCell(x, y, true);
+                this->powerPath.push_back(SnakeBody(x, y));
+            }
+            int direction = random() % 4;
+            int nextX = x + dx[direction];
+            int nextY = y + dy[direction];
+            if (nextX >= 2 && nextX <= width - 2 && nextY >= 1 && nextY <= height - 2
+                && !this->isObstacle(nextX, nextY) && !this->isSpawnZone(nextX, nextY))
+            {
+                x = nextX;
+                y = nextY;
+            }
+        }
+    }
+}
+
+void Map::remapLayer(std::vector<uint64_t>& bits, int oldWidth, int oldHeight)
+{
+    // Rows move when the width changes, copy the overlapping part
+    int width = this->mGameBoardWidth;
+    int height = this->mGameBoardHeight;
+    this->mScratchBits.assign(((size_t)width * height + 63) / 64, 0);
+    for (int y = 0; y < std::min(oldHeight, height); y ++)
+    {
+        for (int x = 0; x < std::min(oldWidth, width); x ++)
+        {
+            size_t oldCell = (size_t)y * oldWidth + x;
+            if ((bits[oldCell / 64] >> (oldCell % 64)) & 1)
+            {
+                size_t cell = (size_t)y * width + x;
+                this->mScratchBits[cell / 64] |= uint64_t(1) << (cell % 64);
+            }
+        }
+    }
+    bits.swap(this->mScratchBits);
+}
+
+void Map::loadLevel(const Level& level)
+{
+    this->mHasLevel = true;
+    this->mGameBoardWidth = level.width;
+    this->mGameBoardHeight = level.height;
+    this->mObstacleBits = level.obstacleBits;
+    this->mPowerPathBits = level.powerPathBits;
+    this->mSpawnPoints = level.spawnPoints;
+    this->mSpawnPointNum = level.spawnCount;
+    this->mSnakeBits.assign(((size_t)level.width * level.height + 63) / 64, 0);
+    // Counted lazily by getObstacleNum, that would touch every page of the layer
+    this->mObstacleNum = -1;
+    this->powerPath.clear();
+    // A mapped level is read-only, its obstacles stay put
+    this->mMovers.clear();
+    this->mMoverBuckets.clear();
+}
+
+bool Map::hasLevel() const
+{
+    return this->mHasLevel;
+}
+
+void Map::initializeWorld(int width, int height, unsigned int seed)
+{
+    this->mGameBoardWidth = width;
+    this->mGameBoardHeight = height;
+    this->mSeed = seed;
+    this->mObstacleBits = nullptr;
+    this->mPowerPathBits = nullptr;
+    this->mObstacleNum = -1;
+    this->powerPath.clear();
+    this->mWorld.reset(width, height,
+        [this](int chunkX, int chunkY, unsigned char* cells) { this->generateWorldChunk(chunkX, chunkY, cells); });
+}
+
+bool Map::isWorld() const
+{
+    return this->mWorld.isActive();
+}
+
+const ChunkGrid& Map::getWorld() const
+{
+    return this->mWorld;
+}
+
+bool Map::hasFixedBounds() const
+{
+    return this->mHasLevel || this->mWorld.isActive();
+}
+
+void Map::generateWorldChunk(int chunkX, int chunkY, unsigned char* cells) const
+{
+    // A hash of the seed and the cell decides every obstacle, so a chunk
+    // comes out the same whenever and in whatever order it is generated
+    for (int i = 0; i < ChunkGrid::kChunkSize; i ++)
+    {
+        for (int j = 0; j < ChunkGrid::kChunkSize; j ++)
+        {
+            int x = chunkX * ChunkGrid::kChunkSize + j;
+            int y = chunkY * ChunkGrid::kChunkSize + i;
+            // Keep the spawn column clear
+            if (this->isSpawnZone(x, y))
+            {
+                continue;
+            }
+            uint64_t hash = ((uint64_t)this->mSeed << 32) ^ ((uint64_t)y << 20) ^ (uint64_t)x;
+            hash += 0x9e3779b97f4a7c15ULL;
+            hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+            hash = hash ^ (hash >> 31);
+            if (hash % 64 == 0)
+            {
+                cells[i * ChunkGrid::kChunkSize + j] = CellObstacle;
+            }
+        }
+    }
+}
+
+void Map::resizeBoard(int gameBoardWidth, int gameBoardHeight)
+{
+    // Levels and worlds define their own bounds independent of the terminal
+    if (this->hasFixedBounds())
+    {
+        return;
+    }
+    int oldWidth = this->mGameBoardWidth;
+    int oldHeight = this->mGameBoardHeight;
+    this->mGameBoardWidth = gameBoardWidth;
+    this->mGameBoardHeight = gameBoardHeight;
+    this->remapLayer(this->mOwnedObstacleBits, oldWidth, oldHeight);
+    this->remapLayer(this->mOwnedPowerPathBits, oldWidth, oldHeight);
+    this->remapLayer(this->mSnakeBits, oldWidth, oldHeight);
+    this->mObstacleBits = this->mOwnedObstacleBits.data();
+    this->mPowerPathBits = this->mOwnedPowerPathBits.data();
+    this->mObstacleNum = -1;
+}
+
+int Map::getWidth() const
+{
+    return this->mGameBoardWidth;
+}
+
+int Map::getHeight() const
+{
+    return this->mGameBoardHeight;
+}
+
+bool Map::testBit(const uint64_t* bits, int x, int y) const
+{
+    if (bits == nullptr || x < 0 || x >= this->mGameBoardWidth || y < 0 || y >= this->mGameBoardHeight)
+    {
+        return false;
+    }
+    size_t cell = (size_t)y * this->mGameBoardWidth + x;
+    return (bits[cell / 64] >> (cell % 64)) & 1;
+}
+
+bool Map::isObstacle(int x, int y) const
+{
+    if (this->mWorld.isActive())
+    {
+        return this->mWorld.get(x, y) & CellObstacle;
+    }
+    return this->testBit(this->mObstacleBits, x, y);
+}
 
-    for (int i = 0; i < this->mInitialObstacleNum; i ++)
+bool Map::isPowerPath(int x, int y) const
+{
+    if (this->mWorld.isActive())
     {
-        this->obstacle.push_back(SnakeBody(centerX + i, centerY));
+        return this->mWorld.get(x, y) & CellPowerPath;
     }
+    return this->testBit(this->mPowerPathBits, x, y);
 }
 
-vector<SnakeBody>& Map::getObstacle()
+unsigned char Map::getCell(int x, int y) const
 {
-    return this->obstacle;
+    // The same bounds Snake::step dies at
+    if (x <= 1 || x >= this->mGameBoardWidth - 1 || y <= 0 || y >= this->mGameBoardHeight - 1)
+    {
+        return CellWall;
+    }
+    if (this->mWorld.isActive())
+    {
+        return this->mWorld.get(x, y);
+    }
+    // One word index for all three layers
+    size_t cell = (size_t)y * this->mGameBoardWidth + x;
+    size_t word = cell / 64;
+    int bit = cell % 64;
+    return ((this->mObstacleBits[word] >> bit) & 1) * CellObstacle
+        | ((this->mPowerPathBits[word] >> bit) & 1) * CellPowerPath
+        | ((this->mSnakeBits[word] >> bit) & 1) * CellSnake;
 }
 
+void Map::setSnakeCell(int x, int y, bool set)
+{
+    if (x < 0 || x >= this->mGameBoardWidth || y < 0 || y >= this->mGameBoardHeight)
+    {
+        return;
+    }
+    if (this->mWorld.isActive())
+    {
+        unsigned char flags = this->mWorld.get(x, y);
+        this->mWorld.set(x, y, set ? (flags | CellSnake) : (flags & ~CellSnake));
+        return;
+    }
+    size_t cell = (size_t)y * this->mGameBoardWidth + x;
+    if (set)
+        this->mSnakeBits[cell / 64] |= uint64_t(1) << (cell % 64);
+    else
+        this->mSnakeBits[cell / 64] &= ~(uint64_t(1) << (cell % 64));
+}
+
+SnakeBody Map::getSpawnPoint(int index) const
+{
+    if (index < 0 || index >= this->mSpawnPointNum)
+    {
+        return SnakeBody(this->mGameBoardWidth / 2, this->mGameBoardHeight / 2);
+    }
+    uint32_t cell = this->mSpawnPoints[index];
+    return SnakeBody(cell % this->mGameBoardWidth, cell / this->mGameBoardWidth);
+}
+
+int Map::getSpawnPointNum() const
+{
+    return this->mSpawnPointNum;
+}
 
 int Map::getObstacleNum()
 {
-    return this->obstacle.size();
+    // Counting a world would generate all of it
+    if (this->mWorld.isActive())
+    {
+        return -1;
+    }
+    if (this->mObstacleNum < 0)
+    {
+        size_t words = ((size_t)this->mGameBoardWidth * this->mGameBoardHeight + 63) / 64;
+        this->mObstacleNum = 0;
+        for (size_t i = 0; i < words; i ++)
+        {
+            this->mObstacleNum += __builtin_popcountll(this->mObstacleBits[i]);
+        }
+    }
+    return this->mObstacleNum;
 }
 
 
-vector<SnakeBody>& Map::getPowerPath()
+const vector<SnakeBody>& Map::getPowerPath() const
 {
     return this->powerPath;
 }
 
-int Map::getPowerPathLength()
+int Map::getPowerPathLength() const
 {
     return this->powerPath.size();
 }
 
-void Map::setPowerPath(vector<SnakeBody> pp)
+void Map::setPowerPathCell(int x, int y, bool set)
+{
+    if (x < 0 || x >= this->mGameBoardWidth || y < 0 || y >= this->mGameBoardHeight)
+    {
+        return;
+    }
+    if (this->mWorld.isActive())
+    {
+        unsigned char flags = this->mWorld.get(x, y);
+        this->mWorld.set(x, y, set ? (flags | CellPowerPath) : (flags & ~CellPowerPath));
+        return;
+    }
+    size_t cell = (size_t)y * this->mGameBoardWidth + x;
+    if (set)
+        this->mOwnedPowerPathBits[cell / 64] |= uint64_t(1) << (cell % 64);
+    else
+        this->mOwnedPowerPathBits[cell / 64] &= ~(uint64_t(1) << (cell % 64));
+}
+
+void Map::setObstacleCell(int x, int y, bool set)
+{
+    if (x < 0 || x >= this->mGameBoardWidth || y < 0 || y >= this->mGameBoardHeight)
+    {
+        return;
+    }
+    if (this->mWorld.isActive())
+    {
+        unsigned char flags = this->mWorld.get(x, y);
+        this->mWorld.set(x, y, set ? (flags | CellObstacle) : (flags & ~CellObstacle));
+        return;
+    }
+    size_t cell = (size_t)y * this->mGameBoardWidth + x;
+    if (set)
+        this->mOwnedObstacleBits[cell / 64] |= uint64_t(1) << (cell % 64);
+    else
+        this->mOwnedObstacleBits[cell / 64] &= ~(uint64_t(1) << (cell % 64));
+}
+
+bool Map::setPowerPath(vector<SnakeBody>&& pp)
 {
-    this->powerPath = pp;
+    // The layer of a mapped level is read-only
+    if (this->mHasLevel)
+    {
+        return false;
+    }
+    for (int i = 0; i < this->powerPath.size(); i ++)
+    {
+        this->setPowerPathCell(this->powerPath[i].getX(), this->powerPath[i].getY(), false);
+    }
+    // Swapping hands the old storage back to the caller for its next path
+    this->powerPath.swap(pp);
+    pp.clear();
+    for (int i = 0; i < this->powerPath.size(); i ++)
+    {
+        this->setPowerPathCell(this->powerPath[i].getX(), this->powerPath[i].getY(), true);
+    }
+    return true;
 }
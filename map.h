@@ -2,29 +2,148 @@
 #define MAP_H_INCLUDED
 
 #include <vector>
+#include <cstdint>
+#include <random>
+#include <functional>
 #include "snake.h"
+#include "level.h"
+#include "chunkgrid.h"
+
+// Per-cell flags stored in a world's ChunkGrid and returned by Map::getCell
+enum CellFlag
+{
+    CellObstacle = 1,
+    CellPowerPath = 2,
+    CellSnake = 4,
+    // Only from getCell, for cells outside the playable area
+    CellWall = 8,
+};
+
+// Knobs of the procedural generator, raise them for harder boards
+struct MapGenParams
+{
+    // Share of the board covered by walls, before unreachable pockets are filled
+    double obstacleDensity = 0.03;
+    // Walls are straight runs of 1 to this many cells
+    int maxWallLength = 6;
+    int powerPathNum = 2;
+    int powerPathLength = 10;
+    // Obstacles that patrol on their own, each one steps every period ticks
+    int movingObstacleNum = 0;
+    int movingObstaclePeriod = 3;
+    // Cells a mover walks before it turns around, or turns right on a loop
+    int patrolLength = 6;
+};
+
+// An obstacle walking a patrol, a line back and forth or a square loop
+struct MovingObstacle
+{
+    int x;
+    int y;
+    // 0 up, 1 right, 2 down, 3 left
+    int direction;
+    int step;
+    int length;
+    bool loop;
+};
 
 
 class Map
 {
 public:
 
-    Map(int gameBoardWidth, int gameBoardHeight, int initialObstacleNum, int initialPowerPathLength);
+    Map(int gameBoardWidth, int gameBoardHeight, const MapGenParams& params, unsigned int seed);
+    // Generates a fresh board from the seed, every free cell reachable from the spawn point
     void initializeMap();
-    std::vector<SnakeBody>& getObstacle();
-    std::vector<SnakeBody>& getPowerPath();
-    void setPowerPath(std::vector<SnakeBody> pp);
-    int getPowerPathLength();
+    void setSeed(unsigned int seed);
+    unsigned int getSeed() const;
+    // Use a mapped level instead of the built-in layout, nothing is copied
+    // so the level's pack has to outlive the map
+    void loadLevel(const Level& level);
+    bool hasLevel() const;
+    // Switch to a sparse world of the given size, generated chunk by chunk from the seed
+    void initializeWorld(int width, int height, unsigned int seed);
+    bool isWorld() const;
+    const ChunkGrid& getWorld() const;
+    // Levels and worlds keep their own bounds whatever the terminal size
+    bool hasFixedBounds() const;
+    // Adopt new board bounds after a terminal resize, keeping the obstacles
+    void resizeBoard(int gameBoardWidth, int gameBoardHeight);
+    int getWidth() const;
+    int getHeight() const;
+    bool isObstacle(int x, int y) const;
+    bool isPowerPath(int x, int y) const;
+    // Every flag of a cell at once, walls included
+    unsigned char getCell(int x, int y) const;
+    // The snake keeps its cells marked here, initializeMap clears them
+    void setSnakeCell(int x, int y, bool set);
+    // Where the snake starts, the board center unless the level has spawn points
+    SnakeBody getSpawnPoint(int index) const;
+    int getSpawnPointNum() const;
+    const std::vector<SnakeBody>& getPowerPath() const;
+    // Replaces the power path cells in the layer, the caller's vector
+    // comes back empty holding the storage of the previous path
+    bool setPowerPath(std::vector<SnakeBody>&& pp);
+    int getPowerPathLength() const;
     int getObstacleNum();
+    // Steps the movers due on this tick, cells the callback reports as
+    // blocked are not entered. Costs only the movers that are due.
+    void moveObstacles(long long tick, const std::function<bool(int, int)>& isBlocked);
+    // Cells vacated and entered by the last moveObstacles, index by index
+    const std::vector<SnakeBody>& getMovedFrom() const;
+    const std::vector<SnakeBody>& getMovedTo() const;
+    int getMovingObstacleNum() const;
+    const std::vector<MovingObstacle>& getMovers() const;
+    // Bytes held by the layers, the generator's scratch, the movers and the world
+    std::size_t getMemoryUsage() const;
+    // The owned obstacle layer of a generated board, movers included
+    const uint64_t* getObstacleBits() const;
+    // Puts back a board as a snapshot saw it. A generated board takes the
+    // saved layer, which already holds the movers; a world is generated
+    // again from the seed and a level has to be the one already loaded.
+    bool restoreBoard(int width, int height, unsigned int seed, const uint64_t* obstacleBits,
+        const std::vector<MovingObstacle>& movers);
 
 private:
+    bool testBit(const uint64_t* bits, int x, int y) const;
+    bool isSpawnZone(int x, int y) const;
+    void setPowerPathCell(int x, int y, bool set);
+    void setObstacleCell(int x, int y, bool set);
+    void spawnMovingObstacles(std::mt19937& random, int minX, int maxX, int minY, int maxY);
+    void generate();
+    void generatePowerPaths(std::mt19937& random);
+    void remapLayer(std::vector<uint64_t>& bits, int oldWidth, int oldHeight);
+    void generateWorldChunk(int chunkX, int chunkY, unsigned char* cells) const;
 
-    std::vector<SnakeBody> obstacle;
+    // Layers of a generated board, reused by every later generation
+    std::vector<uint64_t> mOwnedObstacleBits;
+    std::vector<uint64_t> mOwnedPowerPathBits;
+    // Owned for levels too, their mapped layers are read-only
+    std::vector<uint64_t> mSnakeBits;
+    std::vector<uint64_t> mScratchBits;
+    // Union-find over runs of free cells, kept between generations
+    std::vector<int> mGenParent;
+    std::vector<int> mGenRunStart;
+    std::vector<int> mGenRunEnd;
+    std::vector<int> mGenRunRow;
     std::vector<SnakeBody> powerPath;
-    const int mGameBoardWidth;
-    const int mGameBoardHeight;
-    const int mInitialObstacleNum;
-    const int mInitialPowerPathLength;
+    // Movers are bucketed by the tick they are due on
+    std::vector<MovingObstacle> mMovers;
+    std::vector<std::vector<int> > mMoverBuckets;
+    std::vector<SnakeBody> mMovedFrom;
+    std::vector<SnakeBody> mMovedTo;
+    // Either point into the owned storage or into a mapped level
+    const uint64_t* mObstacleBits;
+    const uint64_t* mPowerPathBits;
+    const uint32_t* mSpawnPoints;
+    int mSpawnPointNum;
+    bool mHasLevel;
+    ChunkGrid mWorld;
+    MapGenParams mParams;
+    unsigned int mSeed;
+    int mObstacleNum;
+    int mGameBoardWidth;
+    int mGameBoardHeight;
 };
 
 #endif // MAP_H_INCLUDED
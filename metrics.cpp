@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+#include "metrics.h"
+
+// Upper bounds of the histogram buckets in microseconds, the last bucket
+// takes everything above
+static const int64_t gBucketBounds[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+static const int gBucketNum = sizeof(gBucketBounds) / sizeof(gBucketBounds[0]) + 1;
+
+// Threads past the last shard share it and pay for atomic adds
+static const int gShardNum = 64;
+
+struct alignas(64) MetricShard
+{
+    std::atomic<uint64_t> counters[MetricCounterNum];
+    std::atomic<uint64_t> buckets[MetricHistogramNum][gBucketNum];
+    // Nanoseconds
+    std::atomic<uint64_t> sums[MetricHistogramNum];
+};
+
+static MetricShard gShards[gShardNum];
+static std::atomic<int> gShardsTaken(0);
+static std::atomic<int64_t> gGauges[MetricGaugeNum];
+static std::atomic<bool> gEnabled(false);
+static thread_local int gShardIndex = -1;
+
+struct MetricInfo
+{
+    const char* name;
+    const char* help;
+};
+
+static const MetricInfo gCounterInfo[MetricCounterNum] = {
+    {"snake_ticks_total", "Ticks played."},
+    {"snake_frames_rendered_total", "Frames drawn to the terminal."},
+    {"snake_frames_dropped_total", "Ticks skipped because the game fell behind."},
+    {"snake_input_events_total", "Keys read from the terminal."},
+    {"snake_food_spawn_retries_total", "Food cells drawn again because they were taken."},
+    {"snake_leaderboard_writes_total", "Leaderboard batches written to disk."},
+};
+
+static const MetricInfo gGaugeInfo[MetricGaugeNum] = {
+    {"snake_length", "Segments of the snake in play."},
+};
+
+static const MetricInfo gHistogramInfo[MetricHistogramNum] = {
+    {"snake_tick_seconds", "Time from reading a tick's key to refreshing its frame."},
+    {"snake_leaderboard_write_seconds", "Time to write and sync one leaderboard batch."},
+};
+
+static MetricShard& getShard()
+{
+    if (gShardIndex < 0)
+    {
+        gShardIndex = std::min(gShardsTaken.fetch_add(1, std::memory_order_relaxed), gShardNum - 1);
+    }
+    return gShards[gShardIndex];
+}
+
+// A plain load and store on a line only this thread writes, an atomic
+// add on the shared last one
+static void add(std::atomic<uint64_t>& value, uint64_t amount)
+{
+    if (gShardIndex < gShardNum - 1)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    else
+    {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+void enableMetrics()
+{
+    gEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool metricsEnabled()
+{
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void countMetric(MetricCounter counter, uint64_t amount)
+{
+    if (!metricsEnabled())
+    {
+        return;
+    }
+    MetricShard& shard = getShard();
+    add(shard.counters[counter], amount);
+}
+
+void setMetric(MetricGauge gauge, int64_t value)
+{
+    if (metricsEnabled())
+    {
+        gGauges[gauge].store(value, std::memory_order_relaxed);
+    }
+}
+
+void observeMetric(MetricHistogram histogram, std::chrono::steady_clock::duration duration)
+{
+    if (!metricsEnabled())
+    {
+        return;
+    }
+    int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    int bucket = 0;
+    while (bucket < gBucketNum - 1 && nanoseconds > gBucketBounds[bucket] * 1000)
+    {
+        bucket ++;
+    }
+    MetricShard& shard = getShard();
+    add(shard.buckets[histogram][bucket], 1);
+    add(shard.sums[histogram], nanoseconds < 0 ? 0 : nanoseconds);
+}
+
+static void appendLine(std::string& text, const char* format, const char* name, const char* label, double value)
+{
+    char line[160];
+    std::snprintf(line, sizeof(line), format, name, label, value);
+    text += line;
+}
+
+void formatMetrics(std::string& text)
+{
+    text.clear();
+    int shardNum = std::min(gShardsTaken.load(std::memory_order_relaxed), gShardNum);
+    for (int i = 0; i < MetricCounterNum; i ++)
+    {
+        uint64_t total = 0;
+        for (int j = 0; j < shardNum; j ++)
+        {
+            total += gShards[j].counters[i].load(std::memory_order_relaxed);
+        }
+        text += std::string("# HELP ") + gCounterInfo[i].name + " " + gCounterInfo[i].help + "\n";
+        text += std::string("# TYPE ") + gCounterInfo[i].name + " counter\n";
+        text += gCounterInfo[i].name + std::string(" ") + std::to_string(total) + "\n";
+    }
+    for (int i = 0; i < MetricGaugeNum; i ++)
+    {
+        text += std::string("# HELP ") + gGaugeInfo[i].name + " " + gGaugeInfo[i].help + "\n";
+        text += std::string("# TYPE ") + gGaugeInfo[i].name + " gauge\n";
+        text += gGaugeInfo[i].name + std::string(" ") + std::to_string(gGauges[i].load(std::memory_order_relaxed)) + "\n";
+    }
+    for (int i = 0; i < MetricHistogramNum; i ++)
+    {
+        const char* name = gHistogramInfo[i].name;
+        text += std::string("# HELP ") + name + " " + gHistogramInfo[i].help + "\n";
+        text += std::string("# TYPE ") + name + " histogram\n";
+        // Buckets are kept apart and made cumulative here
+        uint64_t count = 0;
+        for (int bucket = 0; bucket < gBucketNum; bucket ++)
+        {
+            for (int j = 0; j < shardNum; j ++)
+            {
+                count += gShards[j].buckets[i][bucket].load(std::memory_order_relaxed);
+            }
+            char bound[32];
+            if (bucket < gBucketNum - 1)
+            {
+                std::snprintf(bound, sizeof(bound), "%g", gBucketBounds[bucket] / 1e6);
+            }
+            else
+            {
+                std::snprintf(bound, sizeof(bound), "+Inf");
+            }
+            appendLine(text, "%s_bucket{le=\"%s\"} %.0f\n", name, bound, count);
+        }
+        uint64_t sum = 0;
+        for (int j = 0; j < shardNum; j ++)
+        {
+            sum += gShards[j].sums[i].load(std::memory_order_relaxed);
+        }
+        appendLine(text, "%s_sum%s %.9f\n", name, "", sum / 1e9);
+        appendLine(text, "%s_count%s %.0f\n", name, "", count);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Runtime metrics for monitoring, off until enableMetrics() is called.
+// Every thread counts into its own cache line, written with plain relaxed
+// stores since nobody else writes it; a reader sums the lines of all
+// threads. Nothing is shared between threads on the hot path, so a tick
+// costs the same with metrics on as with them off.
+
+enum MetricCounter
+{
+    MetricTicks,
+    MetricFramesRendered,
+    // Ticks the scheduler skipped because the game fell behind
+    MetricFramesDropped,
+    MetricInputEvents,
+    // Cells drawn for food that turned out to be taken
+    MetricFoodSpawnRetries,
+    MetricLeaderboardWrites,
+    MetricCounterNum,
+};
+
+enum MetricGauge
+{
+    MetricSnakeLength,
+    MetricGaugeNum,
+};
+
+enum MetricHistogram
+{
+    MetricTickTime,
+    MetricLeaderboardWriteTime,
+    MetricHistogramNum,
+};
+
+void enableMetrics();
+bool metricsEnabled();
+void countMetric(MetricCounter counter, uint64_t amount = 1);
+void setMetric(MetricGauge gauge, int64_t value);
+void observeMetric(MetricHistogram histogram, std::chrono::steady_clock::duration duration);
+// Everything counted so far in Prometheus' text exposition format
+void formatMetrics(std::string& text);
+
+#endif
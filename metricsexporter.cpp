@@ -0,0 +1,200 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// For the sockets and the wake-up pipe
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metricsexporter.h"
+#include "metrics.h"
+
+MetricsExporter::MetricsExporter(): mIntervalSeconds(10), mListenFd(-1), mFileFd(-1), mWakeFds{-1, -1}
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    this->stop();
+}
+
+bool MetricsExporter::start(const std::string& target, int intervalSeconds)
+{
+    this->stop();
+    this->mTarget = target;
+    this->mIntervalSeconds = intervalSeconds > 0 ? intervalSeconds : 10;
+    if (target.compare(0, 4, "tcp:") == 0)
+    {
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(std::atoi(target.c_str() + 4));
+        // Only the kiosk itself and a local agent scrape it
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        this->mListenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (this->mListenFd >= 0)
+        {
+            setsockopt(this->mListenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (this->mListenFd < 0 || bind(this->mListenFd, (struct sockaddr*)&address, sizeof(address)) != 0
+            || listen(this->mListenFd, 8) != 0)
+        {
+            this->stop();
+            return false;
+        }
+    }
+    else if (target.compare(0, 5, "unix:") == 0)
+    {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (target.size() - 5 >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        std::strcpy(address.sun_path, target.c_str() + 5);
+        // A socket left behind by a killed process
+        unlink(address.sun_path);
+        this->mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (this->mListenFd < 0 || bind(this->mListenFd, (struct sockaddr*)&address, sizeof(address)) != 0
+            || listen(this->mListenFd, 8) != 0)
+        {
+            this->stop();
+            return false;
+        }
+        this->mSocketPath = address.sun_path;
+    }
+    else
+    {
+        this->mFileFd = open(target.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (this->mFileFd < 0)
+        {
+            return false;
+        }
+    }
+    if (pipe2(this->mWakeFds, O_CLOEXEC) != 0)
+    {
+        this->stop();
+        return false;
+    }
+    enableMetrics();
+    this->mThread = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop()
+{
+    if (this->mThread.joinable())
+    {
+        const char wake = 0;
+        if (write(this->mWakeFds[1], &wake, 1) == 1)
+        {
+            this->mThread.join();
+        }
+        else
+        {
+            this->mThread.detach();
+        }
+    }
+    // The last interval goes out too
+    if (this->mFileFd >= 0)
+    {
+        this->append();
+    }
+    int* fds[] = {&this->mListenFd, &this->mFileFd, &this->mWakeFds[0], &this->mWakeFds[1]};
+    for (int i = 0; i < 4; i ++)
+    {
+        if (*fds[i] >= 0)
+        {
+            close(*fds[i]);
+        }
+        *fds[i] = -1;
+    }
+    if (!this->mSocketPath.empty())
+    {
+        unlink(this->mSocketPath.c_str());
+        this->mSocketPath.clear();
+    }
+}
+
+void MetricsExporter::run()
+{
+    while (true)
+    {
+        struct pollfd fds[2] = {{this->mWakeFds[0], POLLIN, 0}, {this->mListenFd, POLLIN, 0}};
+        int fdNum = this->mListenFd >= 0 ? 2 : 1;
+        int timeout = this->mListenFd >= 0 ? -1 : this->mIntervalSeconds * 1000;
+        int ready = poll(fds, fdNum, timeout);
+        if (ready > 0 && fds[0].revents != 0)
+        {
+            break;
+        }
+        if (ready == 0 && this->mFileFd >= 0)
+        {
+            this->append();
+        }
+        else if (ready > 0 && fdNum > 1 && fds[1].revents != 0)
+        {
+            int client = accept4(this->mListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0)
+            {
+                this->serve(client);
+                close(client);
+            }
+        }
+    }
+}
+
+void MetricsExporter::serve(int client)
+{
+    // Whatever was asked, the answer is the metrics. The request is read
+    // so closing does not reset the connection under the response, a
+    // scraper that never sends one is given up on after a second.
+    char request[1024];
+    struct pollfd poller = {client, POLLIN, 0};
+    if (poll(&poller, 1, 1000) > 0)
+    {
+        ssize_t ignored = read(client, request, sizeof(request));
+        (void)ignored;
+    }
+    formatMetrics(this->mText);
+    std::string header = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+        + std::to_string(this->mText.size()) + "\r\nConnection: close\r\n\r\n";
+    this->mText.insert(0, header);
+    const char* bytes = this->mText.data();
+    std::size_t size = this->mText.size();
+    while (size > 0)
+    {
+        ssize_t written = send(client, bytes, size, MSG_NOSIGNAL);
+        if (written <= 0)
+        {
+            break;
+        }
+        bytes += written;
+        size -= written;
+    }
+}
+
+void MetricsExporter::append()
+{
+    formatMetrics(this->mText);
+    // Each block starts with the time it was taken
+    this->mText.insert(0, "# time " + std::to_string(std::time(nullptr)) + "\n");
+    const char* bytes = this->mText.data();
+    std::size_t size = this->mText.size();
+    while (size > 0)
+    {
+        ssize_t written = write(this->mFileFd, bytes, size);
+        if (written <= 0)
+        {
+            break;
+        }
+        bytes += written;
+        size -= written;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <string>
+#include <thread>
+
+// Hands the metrics out from a thread of its own, so a scrape never
+// holds up a tick. The target picks how:
+//   tcp:port      HTTP on 127.0.0.1
+//   unix:path     HTTP on a UNIX socket, curl --unix-socket reads it
+//   anything else a file the metrics are appended to every interval
+class MetricsExporter
+{
+public:
+    MetricsExporter();
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator = (const MetricsExporter&) = delete;
+
+    // Turns the metrics on, false when the socket or file cannot be opened
+    bool start(const std::string& target, int intervalSeconds);
+    void stop();
+
+private:
+    void run();
+    void serve(int client);
+    void append();
+
+    std::string mTarget;
+    std::string mSocketPath;
+    int mIntervalSeconds;
+    int mListenFd;
+    int mFileFd;
+    // Written to wake the thread when stopping
+    int mWakeFds[2];
+    std::thread mThread;
+    // Reused by every scrape
+    std::string mText;
+};
+
+#endif
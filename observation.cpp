@@ -0,0 +1,372 @@
+#include <climits>
+#include <cstring>
+
+// For shared memory and futexes
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "observation.h"
+#include "engine.h"
+
+static const char gObservationMagic[8] = {'S', 'N', 'K', 'O', 'B', 'S', 'V', '1'};
+static const uint32_t gObservationVersion = 1;
+// Polls of a sequence word before either side sleeps on it, a pause
+// takes tens of cycles so this is some tens of microseconds
+static const int gSpinLimit = 2000;
+
+static std::size_t alignTo(std::size_t size, std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Not the private variants, the other side is another process
+static void futexWait(uint32_t* word, uint32_t value)
+{
+    syscall(SYS_futex, word, FUTEX_WAIT, value, nullptr, nullptr, 0);
+}
+
+static void futexWake(uint32_t* word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Tells the core it is spinning, so a sibling hyperthread keeps its share
+// and the loop does not flood the memory system with loads
+static inline void relaxCpu()
+{
+#if defined(__SSE2__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Spins on the word while it holds value, then sleeps on it. With one CPU
+// the other side cannot run while this one spins, it sleeps right away.
+static uint32_t waitWhileEqual(uint32_t* word, uint32_t value)
+{
+    static const int spinLimit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? gSpinLimit : 0;
+    uint32_t current;
+    for (int i = 0; i < spinLimit; i ++)
+    {
+        if ((current = __atomic_load_n(word, __ATOMIC_ACQUIRE)) != value)
+        {
+            return current;
+        }
+        relaxCpu();
+    }
+    while ((current = __atomic_load_n(word, __ATOMIC_ACQUIRE)) == value)
+    {
+        futexWait(word, value);
+    }
+    return current;
+}
+
+ObservationExporter::ObservationExporter()
+    : mMemory(nullptr), mSize(0), mHeader(nullptr), mSlots(nullptr), mWidth(0), mHeight(0), mRound(0)
+{
+}
+
+ObservationExporter::~ObservationExporter()
+{
+    this->close();
+}
+
+bool ObservationExporter::open(const std::string& name, int width, int height, int slotNum)
+{
+    this->close();
+    std::size_t slotOffset = alignTo(sizeof(ObservationHeader), 64);
+    std::size_t planeOffset = alignTo(slotOffset + slotNum * sizeof(ObservationSlot), 64);
+    std::size_t size = planeOffset + (std::size_t)PlaneNum * width * height;
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        return false;
+    }
+    std::memset(memory, 0, size);
+    this->mName = name;
+    this->mMemory = memory;
+    this->mSize = size;
+    this->mWidth = width;
+    this->mHeight = height;
+    this->mHeader = static_cast<ObservationHeader*>(memory);
+    this->mSlots = reinterpret_cast<ObservationSlot*>(static_cast<char*>(memory) + slotOffset);
+    this->mHeader->version = gObservationVersion;
+    this->mHeader->width = width;
+    this->mHeader->height = height;
+    this->mHeader->planeNum = PlaneNum;
+    this->mHeader->planeOffset = planeOffset;
+    this->mHeader->slotNum = slotNum;
+    this->mHeader->slotOffset = slotOffset;
+    // The magic goes last, a reader seeing it finds the rest filled in
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    std::memcpy(this->mHeader->magic, gObservationMagic, sizeof(gObservationMagic));
+    return true;
+}
+
+void ObservationExporter::close()
+{
+    if (this->mMemory == nullptr)
+    {
+        return;
+    }
+    munmap(this->mMemory, this->mSize);
+    shm_unlink(this->mName.c_str());
+    this->mMemory = nullptr;
+    this->mHeader = nullptr;
+    this->mSlots = nullptr;
+}
+
+unsigned char* ObservationExporter::getPlane(int plane) const
+{
+    return static_cast<unsigned char*>(this->mMemory) + this->mHeader->planeOffset + (std::size_t)plane * this->mWidth * this->mHeight;
+}
+
+void ObservationExporter::setCell(int plane, int x, int y, unsigned char value)
+{
+    if (x < 0 || x >= this->mWidth || y < 0 || y >= this->mHeight)
+    {
+        return;
+    }
+    this->getPlane(plane)[y * this->mWidth + x] = value;
+}
+
+void ObservationExporter::redrawLayer(Engine& engine, int plane)
+{
+    Map& map = engine.getMap();
+    unsigned char* cells = this->getPlane(plane);
+    for (int y = 0; y < this->mHeight; y ++)
+    {
+        for (int x = 0; x < this->mWidth; x ++)
+        {
+            cells[y * this->mWidth + x] = plane == PlaneObstacle ? map.isObstacle(x, y) : map.isPowerPath(x, y);
+        }
+    }
+}
+
+void ObservationExporter::rememberCells(Engine& engine)
+{
+    this->mHead = engine.getSnake().getSnake()[0];
+    this->mFood = engine.getFood();
+}
+
+void ObservationExporter::writeSlot(Engine& engine)
+{
+    uint32_t seq = this->mHeader->observationSeq + 1;
+    ObservationSlot& slot = this->mSlots[seq % this->mHeader->slotNum];
+    const BodyRing& snake = engine.getSnake().getSnake();
+    slot.tick = engine.getTickCount();
+    slot.seq = seq;
+    slot.round = this->mRound;
+    slot.length = snake.size();
+    slot.direction = static_cast<int>(engine.getSnake().getDirection());
+    slot.points = engine.getPoints();
+    slot.dead = engine.isDead();
+    slot.headX = snake[0].getX();
+    slot.headY = snake[0].getY();
+    slot.foodX = engine.getFood().getX();
+    slot.foodY = engine.getFood().getY();
+    // Publishes the slot and the planes written before it
+    __atomic_store_n(&this->mHeader->observationSeq, seq, __ATOMIC_RELEASE);
+    futexWake(&this->mHeader->observationSeq);
+}
+
+void ObservationExporter::beginRound(Engine& engine)
+{
+    this->mRound ++;
+    // Events of earlier rounds are of no interest
+    this->mEvents = engine.getEvents().subscribe();
+    std::memset(this->getPlane(PlaneBody), 0, (std::size_t)3 * this->mWidth * this->mHeight);
+    const BodyRing& snake = engine.getSnake().getSnake();
+    for (int i = 0; i < snake.size(); i ++)
+    {
+        this->setCell(PlaneBody, snake[i].getX(), snake[i].getY(), 1);
+    }
+    if (!snake.empty())
+    {
+        this->setCell(PlaneHead, snake[0].getX(), snake[0].getY(), 1);
+    }
+    this->setCell(PlaneFood, engine.getFood().getX(), engine.getFood().getY(), 1);
+    this->redrawLayer(engine, PlaneObstacle);
+    this->redrawLayer(engine, PlanePowerPath);
+    this->rememberCells(engine);
+    this->writeSlot(engine);
+}
+
+void ObservationExporter::publish(Engine& engine, const SnakeStep& step)
+{
+    // The same cells renderTickChanges draws: the dropped tail, the movers,
+    // the new head and the food
+    for (int i = 0; i < step.freedNum; i ++)
+    {
+        this->setCell(PlaneBody, step.freed[i].getX(), step.freed[i].getY(), 0);
+    }
+    const BodyRing& snake = engine.getSnake().getSnake();
+    this->setCell(PlaneHead, this->mHead.getX(), this->mHead.getY(), 0);
+    this->setCell(PlaneBody, snake[0].getX(), snake[0].getY(), 1);
+    this->setCell(PlaneHead, snake[0].getX(), snake[0].getY(), 1);
+    this->setCell(PlaneFood, this->mFood.getX(), this->mFood.getY(), 0);
+    this->setCell(PlaneFood, engine.getFood().getX(), engine.getFood().getY(), 1);
+    const std::vector<SnakeBody>& movedFrom = engine.getMap().getMovedFrom();
+    const std::vector<SnakeBody>& movedTo = engine.getMap().getMovedTo();
+    for (int i = 0; i < movedFrom.size(); i ++)
+    {
+        this->setCell(PlaneObstacle, movedFrom[i].getX(), movedFrom[i].getY(), 0);
+        this->setCell(PlaneObstacle, movedTo[i].getX(), movedTo[i].getY(), 1);
+    }
+    EngineEvent event;
+    while (this->mEvents.poll(event))
+    {
+        if (event.type == EngineEventType::PowerPathMoved)
+        {
+            this->redrawLayer(engine, PlanePowerPath);
+        }
+    }
+    this->rememberCells(engine);
+    this->writeSlot(engine);
+}
+
+int ObservationExporter::waitForAction()
+{
+    uint32_t seq = this->mHeader->observationSeq;
+    uint32_t* actionSeq = &this->mHeader->actionSeq;
+    // A trainer answering within microseconds is caught without a syscall
+    uint32_t current = __atomic_load_n(actionSeq, __ATOMIC_ACQUIRE);
+    while (current != seq)
+    {
+        current = waitWhileEqual(actionSeq, current);
+    }
+    return this->mHeader->action;
+}
+
+void ObservationExporter::serve(Engine& engine, unsigned int seed)
+{
+    while (true)
+    {
+        engine.initializeRound(seed ++);
+        engine.spawnItems();
+        this->beginRound(engine);
+        while (true)
+        {
+            int action = this->waitForAction();
+            if (action < 0)
+            {
+                return;
+            }
+            // The dead observation has been seen, start the next round
+            if (engine.isDead())
+            {
+                break;
+            }
+            if (action <= static_cast<int>(Direction::Right))
+            {
+                engine.getSnake().changeDirection(static_cast<Direction>(action));
+            }
+            this->publish(engine, engine.step(0));
+        }
+    }
+}
+
+ObservationClient::ObservationClient(): mMemory(nullptr), mSize(0), mHeader(nullptr), mSlots(nullptr), mSeq(0)
+{
+}
+
+ObservationClient::~ObservationClient()
+{
+    this->close();
+}
+
+bool ObservationClient::open(const std::string& name)
+{
+    this->close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(ObservationHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* memory = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        return false;
+    }
+    ObservationHeader* header = static_cast<ObservationHeader*>(memory);
+    // The magic is written last, once it is there the rest is too
+    bool ready = std::memcmp(header->magic, gObservationMagic, sizeof(gObservationMagic)) == 0;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (!ready || header->version != gObservationVersion
+        || header->planeOffset + (std::size_t)header->planeNum * header->width * header->height > (std::size_t)info.st_size)
+    {
+        munmap(memory, info.st_size);
+        return false;
+    }
+    this->mMemory = memory;
+    this->mSize = info.st_size;
+    this->mHeader = header;
+    this->mSlots = reinterpret_cast<ObservationSlot*>(static_cast<char*>(memory) + header->slotOffset);
+    this->mSeq = __atomic_load_n(&header->actionSeq, __ATOMIC_ACQUIRE);
+    return true;
+}
+
+void ObservationClient::close()
+{
+    if (this->mMemory == nullptr)
+    {
+        return;
+    }
+    munmap(this->mMemory, this->mSize);
+    this->mMemory = nullptr;
+    this->mHeader = nullptr;
+    this->mSlots = nullptr;
+}
+
+const ObservationHeader& ObservationClient::getHeader() const
+{
+    return *this->mHeader;
+}
+
+const unsigned char* ObservationClient::getPlane(int plane) const
+{
+    return static_cast<const unsigned char*>(this->mMemory) + this->mHeader->planeOffset
+        + (std::size_t)plane * this->mHeader->width * this->mHeader->height;
+}
+
+const ObservationSlot& ObservationClient::waitForObservation()
+{
+    this->mSeq = waitWhileEqual(&this->mHeader->observationSeq, this->mSeq);
+    return this->mSlots[this->mSeq % this->mHeader->slotNum];
+}
+
+void ObservationClient::answer(int action)
+{
+    this->mHeader->action = action;
+    // Publishes the action written before it
+    __atomic_store_n(&this->mHeader->actionSeq, this->mSeq, __ATOMIC_RELEASE);
+    futexWake(&this->mHeader->actionSeq);
+}
@@ -0,0 +1,131 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include <cstdint>
+#include <string>
+
+#include "snake.h"
+#include "eventbus.h"
+
+class Engine;
+
+/*
+ * Shared memory layout, all offsets from the start of the mapping:
+ *   ObservationHeader
+ *   slotNum ObservationSlots, a ring indexed by observationSeq % slotNum
+ *   planeNum planes of width * height bytes, row major, 1 where set:
+ *     body, head, food, obstacles, power path
+ * The exporter writes an observation, bumps observationSeq and wakes the
+ * trainer. The trainer writes its action (a Direction, or -1 to stop),
+ * sets actionSeq to the observationSeq it answers and wakes the exporter.
+ * Both sequence words are futex words, waiters spin briefly before they
+ * sleep. The planes are updated in place from the cells the last step
+ * changed, so they always describe the newest slot; older slots keep
+ * their scalars only.
+ */
+struct ObservationHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t planeNum;
+    uint32_t planeOffset;
+    uint32_t slotNum;
+    uint32_t slotOffset;
+    // Each futex word on its own cache line
+    alignas(64) uint32_t observationSeq;
+    alignas(64) uint32_t actionSeq;
+    int32_t action;
+};
+
+struct ObservationSlot
+{
+    uint64_t tick;
+    uint32_t seq;
+    uint32_t round;
+    int32_t length;
+    int32_t direction;
+    int32_t points;
+    int32_t dead;
+    int32_t headX;
+    int32_t headY;
+    int32_t foodX;
+    int32_t foodY;
+};
+
+enum ObservationPlane
+{
+    PlaneBody = 0,
+    PlaneHead,
+    PlaneFood,
+    PlaneObstacle,
+    PlanePowerPath,
+    PlaneNum,
+};
+
+// Publishes an Engine's state to an external trainer through POSIX shared memory
+class ObservationExporter
+{
+public:
+    ObservationExporter();
+    ~ObservationExporter();
+    bool open(const std::string& name, int width, int height, int slotNum);
+    void close();
+    // Redraws every plane, at the start of a round
+    void beginRound(Engine& engine);
+    // Applies the cells the last step changed and hands the slot to the trainer
+    void publish(Engine& engine, const SnakeStep& step);
+    // Blocks until the trainer answers the last observation
+    int waitForAction();
+    // Plays rounds from seed on, one step per answer, until the trainer
+    // answers -1
+    void serve(Engine& engine, unsigned int seed);
+
+private:
+    unsigned char* getPlane(int plane) const;
+    void setCell(int plane, int x, int y, unsigned char value);
+    void redrawLayer(Engine& engine, int plane);
+    void writeSlot(Engine& engine);
+    void rememberCells(Engine& engine);
+
+    std::string mName;
+    void* mMemory;
+    std::size_t mSize;
+    ObservationHeader* mHeader;
+    ObservationSlot* mSlots;
+    int mWidth;
+    int mHeight;
+    uint32_t mRound;
+    // What the head and food planes show, to undo it after the next step
+    SnakeBody mHead;
+    SnakeBody mFood;
+    EventSubscriber mEvents;
+};
+
+// The trainer's side of the segment, for tools written in C++ and the
+// round trip check
+class ObservationClient
+{
+public:
+    ObservationClient();
+    ~ObservationClient();
+    // False until the exporter has created and filled in the segment
+    bool open(const std::string& name);
+    void close();
+    const ObservationHeader& getHeader() const;
+    const unsigned char* getPlane(int plane) const;
+    // Blocks until the exporter publishes past the last answered observation
+    const ObservationSlot& waitForObservation();
+    // A Direction, anything above keeps the heading, -1 stops the exporter
+    void answer(int action);
+
+private:
+    void* mMemory;
+    std::size_t mSize;
+    ObservationHeader* mHeader;
+    ObservationSlot* mSlots;
+    uint32_t mSeq;
+};
+
+#endif
@@ -0,0 +1,365 @@
+#include <algorithm>
+
+#include "reachability.h"
+#include "map.h"
+
+Reachability::Reachability() : mWidth(0), mHeight(0), mStamp(0)
+{
+}
+
+void Reachability::clear()
+{
+    // Keeps the storage for the next rebuild
+    this->mWidth = 0;
+    this->mHeight = 0;
+    this->mSizes.clear();
+    this->mFreeLabels.clear();
+}
+
+bool Reachability::isActive() const
+{
+    return this->mWidth > 0;
+}
+
+void Reachability::rebuild(const Map& map, const BodyRing& snake)
+{
+    this->mWidth = map.getWidth();
+    this->mHeight = map.getHeight();
+    int cellNum = this->mWidth * this->mHeight;
+    this->mLabels.assign(cellNum, 0);
+    this->mVisitStamp.assign(cellNum, 0);
+    this->mVisitFlood.assign(cellNum, 0);
+    this->mStamp = 0;
+    this->mSizes.assign(1, 0);
+    this->mFreeLabels.clear();
+    // None of the lists can outgrow the board, reserved so ticks never grow them
+    this->mSizes.reserve(cellNum + 1);
+    this->mFreeLabels.reserve(cellNum + 1);
+    this->mStack.reserve(cellNum);
+    for (int i = 0; i < 4; i ++)
+    {
+        this->mQueues[i].reserve(cellNum);
+    }
+    // -1 marks a free cell that has no region yet, the playable
+    // area is x in [2, width - 2] and y in [1, height - 2]
+    for (int y = 1; y <= this->mHeight - 2; y ++)
+    {
+        for (int x = 2; x <= this->mWidth - 2; x ++)
+        {
+            if (!map.isObstacle(x, y))
+            {
+                this->mLabels[y * this->mWidth + x] = -1;
+            }
+        }
+    }
+    for (int i = 0; i < snake.size(); i ++)
+    {
+        int x = snake[i].getX();
+        int y = snake[i].getY();
+        if (x >= 0 && x < this->mWidth && y >= 0 && y < this->mHeight)
+        {
+            this->mLabels[y * this->mWidth + x] = 0;
+        }
+    }
+    for (int cell = 0; cell < cellNum; cell ++)
+    {
+        if (this->mLabels[cell] == -1)
+        {
+            this->relabel(cell, -1, this->newLabel());
+        }
+    }
+}
+
+int Reachability::newLabel()
+{
+    if (!this->mFreeLabels.empty())
+    {
+        int label = this->mFreeLabels.back();
+        this->mFreeLabels.pop_back();
+        this->mSizes[label] = 0;
+        return label;
+    }
+    this->mSizes.push_back(0);
+    return this->mSizes.size() - 1;
+}
+
+void Reachability::relabel(int cell, int from, int to)
+{
+    // Depth first over the cells labelled from, they all move to the region to
+    const int offsets[] = {-1, 1, -this->mWidth, this->mWidth};
+    this->mStack.clear();
+    this->mStack.push_back(cell);
+    this->mLabels[cell] = to;
+    while (!this->mStack.empty())
+    {
+        int current = this->mStack.back();
+        this->mStack.pop_back();
+        this->mSizes[to] ++;
+        for (int i = 0; i < 4; i ++)
+        {
+            int next = current + offsets[i];
+            if (this->mLabels[next] == from)
+            {
+                this->mLabels[next] = to;
+                this->mStack.push_back(next);
+            }
+        }
+    }
+}
+
+int Reachability::getLabel(int x, int y) const
+{
+    if (x < 2 || x > this->mWidth - 2 || y < 1 || y > this->mHeight - 2)
+    {
+        return 0;
+    }
+    return this->mLabels[y * this->mWidth + x];
+}
+
+bool Reachability::isFree(int x, int y) const
+{
+    return this->getLabel(x, y) > 0;
+}
+
+int Reachability::getRegionSize(int x, int y) const
+{
+    int label = this->getLabel(x, y);
+    return label > 0 ? this->mSizes[label] : 0;
+}
+
+int Reachability::getSpaceAround(int x, int y) const
+{
+    const int dx[] = {-1, 1, 0, 0};
+    const int dy[] = {0, 0, -1, 1};
+    int labels[4];
+    int space = 0;
+    for (int i = 0; i < 4; i ++)
+    {
+        labels[i] = this->getLabel(x + dx[i], y + dy[i]);
+        if (labels[i] > 0 && std::find(labels, labels + i, labels[i]) == labels + i)
+        {
+            space += this->mSizes[labels[i]];
+        }
+    }
+    return space;
+}
+
+void Reachability::freeCell(int x, int y)
+{
+    if (!this->isActive() || x < 2 || x > this->mWidth - 2 || y < 1 || y > this->mHeight - 2)
+    {
+        return;
+    }
+    int cell = y * this->mWidth + x;
+    if (this->mLabels[cell] != 0)
+    {
+        return;
+    }
+    const int offsets[] = {-1, 1, -this->mWidth, this->mWidth};
+    // The cell joins the largest region around it
+    int largest = 0;
+    for (int i = 0; i < 4; i ++)
+    {
+        int label = this->mLabels[cell + offsets[i]];
+        if (label > 0 && (largest == 0 || this->mSizes[label] > this->mSizes[largest]))
+        {
+            largest = label;
+        }
+    }
+    if (largest == 0)
+    {
+        largest = this->newLabel();
+    }
+    this->mLabels[cell] = largest;
+    this->mSizes[largest] ++;
+    // and the smaller ones are relabelled into it
+    for (int i = 0; i < 4; i ++)
+    {
+        int label = this->mLabels[cell + offsets[i]];
+        if (label > 0 && label != largest)
+        {
+            this->relabel(cell + offsets[i], label, largest);
+            this->mSizes[label] = 0;
+            this->mFreeLabels.push_back(label);
+        }
+    }
+}
+
+void Reachability::blockCell(int x, int y)
+{
+    if (!this->isActive() || x < 2 || x > this->mWidth - 2 || y < 1 || y > this->mHeight - 2)
+    {
+        return;
+    }
+    int cell = y * this->mWidth + x;
+    int label = this->mLabels[cell];
+    if (label <= 0)
+    {
+        return;
+    }
+    this->mLabels[cell] = 0;
+    this->mSizes[label] --;
+    if (this->mSizes[label] == 0)
+    {
+        this->mFreeLabels.push_back(label);
+        return;
+    }
+    this->splitAround(cell, label);
+}
+
+int Reachability::findFlood(int flood)
+{
+    while (this->mFloodParent[flood] != flood)
+    {
+        flood = this->mFloodParent[flood];
+    }
+    return flood;
+}
+
+void Reachability::splitAround(int cell, int label)
+{
+    const int width = this->mWidth;
+    // The eight cells around, clockwise from the top, every even one a 4-neighbour.
+    // Consecutive ring cells touch, so a run of free ones is joined around the cell.
+    const int ring[] = {-width, -width + 1, 1, width + 1, width, width - 1, -1, -width - 1};
+    bool free[8];
+    for (int i = 0; i < 8; i ++)
+    {
+        free[i] = this->mLabels[cell + ring[i]] == label;
+    }
+    // Start scanning just after a blocked ring cell so no run wraps around
+    int start = 0;
+    while (start < 8 && free[start])
+    {
+        start ++;
+    }
+    if (start == 8)
+    {
+        return;
+    }
+    int floodNum = 0;
+    bool inRun = false;
+    bool runHasSeed = false;
+    for (int i = 1; i <= 8; i ++)
+    {
+        int position = (start + i) % 8;
+        if (!free[position])
+        {
+            inRun = false;
+            continue;
+        }
+        if (!inRun)
+        {
+            inRun = true;
+            runHasSeed = false;
+        }
+        if (position % 2 == 0 && !runHasSeed)
+        {
+            runHasSeed = true;
+            this->mQueues[floodNum].clear();
+            this->mQueues[floodNum].push_back(cell + ring[position]);
+            floodNum ++;
+        }
+    }
+    if (floodNum <= 1)
+    {
+        return;
+    }
+
+    // One flood per side in lock step, floods that meet are the same side
+    this->mStamp ++;
+    if (this->mStamp == 0)
+    {
+        std::fill(this->mVisitStamp.begin(), this->mVisitStamp.end(), 0);
+        this->mStamp = 1;
+    }
+    bool retired[4] = {false, false, false, false};
+    for (int f = 0; f < floodNum; f ++)
+    {
+        this->mQueueHeads[f] = 0;
+        this->mFloodParent[f] = f;
+        int seed = this->mQueues[f][0];
+        this->mVisitStamp[seed] = this->mStamp;
+        this->mVisitFlood[seed] = f;
+    }
+    const int offsets[] = {-1, 1, -width, width};
+    while (true)
+    {
+        for (int f = 0; f < floodNum; f ++)
+        {
+            if (retired[f] || this->mQueueHeads[f] >= this->mQueues[f].size())
+            {
+                continue;
+            }
+            int current = this->mQueues[f][this->mQueueHeads[f] ++];
+            for (int i = 0; i < 4; i ++)
+            {
+                int next = current + offsets[i];
+                if (this->mLabels[next] != label)
+                {
+                    continue;
+                }
+                if (this->mVisitStamp[next] == this->mStamp)
+                {
+                    int a = this->findFlood(f);
+                    int b = this->findFlood(this->mVisitFlood[next]);
+                    if (a != b)
+                    {
+                        this->mFloodParent[b] = a;
+                    }
+                    continue;
+                }
+                this->mVisitStamp[next] = this->mStamp;
+                this->mVisitFlood[next] = f;
+                this->mQueues[f].push_back(next);
+            }
+        }
+        // Sides still open, and whether each ran dry
+        int sideNum = 0;
+        int drySide = -1;
+        for (int f = 0; f < floodNum; f ++)
+        {
+            if (retired[f] || this->findFlood(f) != f)
+            {
+                continue;
+            }
+            sideNum ++;
+            bool dry = true;
+            for (int g = 0; g < floodNum; g ++)
+            {
+                if (!retired[g] && this->findFlood(g) == f && this->mQueueHeads[g] < this->mQueues[g].size())
+                {
+                    dry = false;
+                }
+            }
+            if (dry && drySide < 0)
+            {
+                drySide = f;
+            }
+        }
+        if (sideNum <= 1)
+        {
+            return;
+        }
+        if (drySide < 0)
+        {
+            continue;
+        }
+        // A side that ran dry is cut off from the others, it becomes a region
+        int split = this->newLabel();
+        for (int g = 0; g < floodNum; g ++)
+        {
+            if (retired[g] || this->findFlood(g) != drySide)
+            {
+                continue;
+            }
+            for (int i = 0; i < this->mQueues[g].size(); i ++)
+            {
+                this->mLabels[this->mQueues[g][i]] = split;
+            }
+            this->mSizes[split] += this->mQueues[g].size();
+            this->mSizes[label] -= this->mQueues[g].size();
+            retired[g] = true;
+        }
+    }
+}
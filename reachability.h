@@ -0,0 +1,60 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include <vector>
+
+#include "snake.h"
+
+class Map;
+
+/*
+ * Connected regions of free cells, kept up to date one cell at a time
+ * instead of flood filling the board every tick. Every free cell carries
+ * the label of its region and every label its size.
+ * Freeing a cell joins the regions around it, relabelling the smaller
+ * ones into the largest. Blocking a cell can only split its region when
+ * its free neighbours are not already joined around it; then one flood
+ * per side runs in lock step and every side that runs dry first becomes
+ * a region of its own. The cost of a split is bounded by the smaller
+ * sides, never the whole board.
+ */
+class Reachability
+{
+public:
+    Reachability();
+    // Labels the board from scratch, walls, obstacles and the body are blocked
+    void rebuild(const Map& map, const BodyRing& snake);
+    void clear();
+    bool isActive() const;
+    void freeCell(int x, int y);
+    void blockCell(int x, int y);
+    bool isFree(int x, int y) const;
+    // Cells reachable from a free cell, 0 for blocked ones
+    int getRegionSize(int x, int y) const;
+    // Cells reachable from the head, through any of its free neighbours
+    int getSpaceAround(int x, int y) const;
+
+private:
+    int getLabel(int x, int y) const;
+    int newLabel();
+    void relabel(int cell, int from, int to);
+    void splitAround(int cell, int label);
+    int findFlood(int flood);
+
+    int mWidth;
+    int mHeight;
+    // 0 for blocked cells, region labels start at 1
+    std::vector<int> mLabels;
+    std::vector<int> mSizes;
+    std::vector<int> mFreeLabels;
+    // Flood state, kept between calls so ticks do not allocate
+    std::vector<int> mStack;
+    std::vector<unsigned int> mVisitStamp;
+    std::vector<unsigned char> mVisitFlood;
+    unsigned int mStamp;
+    std::vector<int> mQueues[4];
+    int mQueueHeads[4];
+    int mFloodParent[4];
+};
+
+#endif
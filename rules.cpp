@@ -0,0 +1,18 @@
+#include <cmath>
+
+#include "rules.h"
+
+int SteppedSpeed::delay(int baseDelay, int points)
+{
+    return baseDelay * pow(0.75, points / 5);
+}
+
+int ConstantSpeed::delay(int baseDelay, int /*points*/)
+{
+    return baseDelay;
+}
+
+DelayCurve selectDelayCurve(SpeedRule rule)
+{
+    return rule == SpeedRule::Constant ? ConstantSpeed::delay : SteppedSpeed::delay;
+}
@@ -0,0 +1,110 @@
+#ifndef RULES_H
+#define RULES_H
+
+// The rules of a round as policies. Snake::step is instantiated once per
+// combination, so a tick never branches on which rules are in play; the
+// combination is picked once when a round's rules are set.
+
+enum class WallRule
+{
+    Solid,
+    // Leaving the board enters it again on the opposite side
+    Wrap,
+};
+
+enum class ObstacleRule
+{
+    // Holding the survive key through an obstacle costs a segment
+    SurviveOnKey,
+    Fatal,
+};
+
+enum class SpeedRule
+{
+    // A quarter faster every fifth food
+    Stepped,
+    Constant,
+};
+
+struct RuleParams
+{
+    WallRule walls = WallRule::Solid;
+    ObstacleRule obstacles = ObstacleRule::SurviveOnKey;
+    // Segments added per food, from 1 to kMaxGrowth
+    int growth = 1;
+    SpeedRule speed = SpeedRule::Stepped;
+    // A power-up appears every powerUpInterval ticks and is gone after
+    // powerUpLifetime, its effect lasts effectDuration. 0 turns them off.
+    int powerUpInterval = 80;
+    int powerUpLifetime = 60;
+    int effectDuration = 50;
+};
+
+const int kMaxGrowth = 3;
+
+// The playable area is x in [2, width - 2] and y in [1, height - 2]
+struct SolidWalls
+{
+    static void apply(int& /*x*/, int& /*y*/, int /*width*/, int /*height*/)
+    {
+    }
+};
+
+struct WrapWalls
+{
+    static void apply(int& x, int& y, int width, int height)
+    {
+        x = x < 2 ? width - 2 : (x > width - 2 ? 2 : x);
+        y = y < 1 ? height - 2 : (y > height - 2 ? 1 : y);
+    }
+};
+
+struct SurviveOnKey
+{
+    // Tail cells given up on top of the usual one
+    static const int kPenalty = 1;
+    static bool survives(int key, int length)
+    {
+        return (key == 'g' || key == 'G') && length >= 2;
+    }
+};
+
+struct FatalObstacles
+{
+    static const int kPenalty = 0;
+    static bool survives(int /*key*/, int /*length*/)
+    {
+        return false;
+    }
+};
+
+template <int Segments>
+struct Growth
+{
+    static const int kSegments = Segments;
+};
+
+template <class Walls, class Obstacles, class Grow>
+struct RuleSet
+{
+    typedef Walls WallPolicy;
+    typedef Obstacles ObstaclePolicy;
+    typedef Grow GrowthPolicy;
+};
+
+// Tick interval for a base interval and the points of the round
+typedef int (*DelayCurve)(int baseDelay, int points);
+
+struct SteppedSpeed
+{
+    static int delay(int baseDelay, int points);
+};
+
+struct ConstantSpeed
+{
+    static int delay(int baseDelay, int points);
+};
+
+DelayCurve selectDelayCurve(SpeedRule rule);
+
+#endif
@@ -0,0 +1,50 @@
+#include "scheduler.h"
+
+TickScheduler::TickScheduler(): mInterval(100), mRateScale(1.0), mNextTick(std::chrono::steady_clock::now())
+{
+}
+
+void TickScheduler::setInterval(std::chrono::milliseconds interval)
+{
+    this->mInterval = interval;
+}
+
+void TickScheduler::setRateScale(double scale)
+{
+    this->mRateScale = scale > 0 ? scale : 1.0;
+}
+
+double TickScheduler::getRateScale() const
+{
+    return this->mRateScale;
+}
+
+std::chrono::microseconds TickScheduler::getEffectiveInterval() const
+{
+    return std::chrono::microseconds((long long)(this->mInterval.count() * 1000 / this->mRateScale));
+}
+
+void TickScheduler::reset()
+{
+    this->mNextTick = std::chrono::steady_clock::now();
+}
+
+std::chrono::steady_clock::time_point TickScheduler::getNextTick() const
+{
+    return this->mNextTick;
+}
+
+int TickScheduler::advance()
+{
+    std::chrono::microseconds interval = this->getEffectiveInterval();
+    this->mNextTick += interval;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    // Fell more than a tick behind, do not try to catch up with a burst
+    if (this->mNextTick < now)
+    {
+        int skipped = interval.count() > 0 ? (now - this->mNextTick) / interval : 0;
+        this->mNextTick = now;
+        return skipped;
+    }
+    return 0;
+}
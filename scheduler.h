@@ -0,0 +1,33 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+
+// Paces the game loop on absolute deadlines, so the time spent rendering
+// a frame does not add to the delay. Effects such as power paths scale
+// the rate without touching the difficulty's base interval.
+class TickScheduler
+{
+public:
+    TickScheduler();
+    // Base interval between ticks, set from the difficulty
+    void setInterval(std::chrono::milliseconds interval);
+    // Ticks per base interval, 2.0 runs twice as fast
+    void setRateScale(double scale);
+    double getRateScale() const;
+    std::chrono::microseconds getEffectiveInterval() const;
+    // Restart the deadlines from now, after a pause or a restart
+    void reset();
+    // When the next tick is due, the event loop sleeps until then
+    std::chrono::steady_clock::time_point getNextTick() const;
+    // Moves the deadline on by one interval after a tick ran, the ticks
+    // skipped when it fell behind
+    int advance();
+
+private:
+    std::chrono::milliseconds mInterval;
+    double mRateScale;
+    std::chrono::steady_clock::time_point mNextTick;
+};
+
+#endif
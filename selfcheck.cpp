@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "selfcheck.h"
+#include "alloccount.h"
+#include "controller.h"
+#include "engine.h"
+#include "game.h"
+#include "observation.h"
+#include "sharedleaderboard.h"
+#include "snapshot.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Every buffer has reached its working size by then
+static const long long gWarmupTicks = 10000;
+// A round is given up once the snake goes this long without food
+static const int gStarvationTicks = 2000;
+// The screen the check draws on, the game board is 80 by 30
+static const char* gScreenColumns = "98";
+static const char* gScreenLines = "36";
+// Entries every process of the shared leaderboard check tries to insert
+static const int gSharedInserts = 100;
+// Processes killed in every round of it
+static const int gSharedKills = 2;
+// The view a world round is played in
+static const int gViewWidth = 80;
+static const int gViewHeight = 30;
+
+// Heads for the food over cells that are not deadly, or takes any such cell
+static int chooseKey(Engine& engine)
+{
+    const int keys[] = {'w', 's', 'a', 'd'};
+    const int dx[] = {0, 0, -1, 1};
+    const int dy[] = {-1, 1, 0, 0};
+    SnakeBody head = engine.getSnake().getSnake()[0];
+    const SnakeBody& food = engine.getFood();
+    int best = -1;
+    int bestDistance = 0;
+    for (int i = 0; i < 4; i ++)
+    {
+        int x = head.getX() + dx[i];
+        int y = head.getY() + dy[i];
+        if (engine.isDeadly(x, y))
+        {
+            continue;
+        }
+        int distance = std::abs(food.getX() - x) + std::abs(food.getY() - y);
+        if (best < 0 || distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    return best < 0 ? ERR : keys[best];
+}
+
+bool checkTickAllocations(long long ticks)
+{
+    if (!allocationCountingEnabled())
+    {
+        std::cerr << "Allocations are not counted, build with -DSNAKE_COUNT_ALLOCATIONS" << std::endl;
+        return false;
+    }
+    // Rounds save their scores to the working directory, keep them out of the real one
+    char directory[] = "/tmp/snake-check-XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) != 0)
+    {
+        std::cerr << "Cannot create a scratch directory" << std::endl;
+        return false;
+    }
+    if (std::getenv("TERM") == nullptr)
+    {
+        setenv("TERM", "xterm", 1);
+    }
+    setenv("COLUMNS", gScreenColumns, 1);
+    setenv("LINES", gScreenLines, 1);
+    FILE* output = std::fopen("/dev/null", "w");
+    int keys[2];
+    if (output == nullptr || pipe(keys) != 0)
+    {
+        std::cerr << "Cannot open the screen for the check" << std::endl;
+        return false;
+    }
+    FILE* input = fdopen(keys[0], "r");
+
+    long long played = 0;
+    std::size_t warmupTicks = 0;
+    std::size_t warmupAllocatingTicks = 0;
+    std::size_t warmupAllocations = 0;
+    std::size_t steadyTicks = 0;
+    std::size_t allocatingTicks = 0;
+    std::size_t allocations = 0;
+    {
+        Game game(output, input);
+        game.setBaseDelay(0);
+        // Patrolling obstacles step every few ticks, their redraws are counted too
+        game.getMapGenParams().movingObstacleNum = 4;
+        // Keeps the reachable regions up to date on every tick
+        game.setDangerOverlay(true);
+        game.setKeyScript([&](Engine& engine)
+        {
+            if (played == gWarmupTicks)
+            {
+                warmupTicks = game.getSteadyTicks();
+                warmupAllocatingTicks = game.getAllocatingTicks();
+                warmupAllocations = game.getSteadyAllocations();
+            }
+            played ++;
+            // One newline per tick for the game to read, it also picks
+            // Restart once the snake dies; past the budget pause and quit
+            const char* pressed = played < gWarmupTicks + ticks ? "\n" : "pss\n";
+            ssize_t written = write(keys[1], pressed, std::strlen(pressed));
+            (void)written;
+            return chooseKey(engine);
+        });
+        game.startGame();
+        steadyTicks = game.getSteadyTicks() - warmupTicks;
+        allocatingTicks = game.getAllocatingTicks() - warmupAllocatingTicks;
+        allocations = game.getSteadyAllocations() - warmupAllocations;
+    }
+    std::fclose(input);
+    std::fclose(output);
+    close(keys[1]);
+    unlink("record.dat");
+    unlink("record.shm");
+    rmdir(directory);
+
+    std::cout << steadyTicks << " ticks after " << gWarmupTicks << " warm-up ticks: "
+              << allocations << " allocations in " << allocatingTicks << " of them" << std::endl;
+    return allocations == 0;
+}
+
+// Region size of every cell found by a breadth first search over the
+// board, blocked the way Reachability::rebuild blocks it
+static void labelRegions(Engine& engine, std::vector<int>& sizes, std::vector<int>& queue)
+{
+    const Map& map = engine.getMap();
+    const BodyRing& snake = engine.getSnake().getSnake();
+    int width = map.getWidth();
+    int height = map.getHeight();
+    // -1 free and not yet searched, 0 blocked, region sizes otherwise
+    sizes.assign(width * height, 0);
+    for (int y = 1; y <= height - 2; y ++)
+    {
+        for (int x = 2; x <= width - 2; x ++)
+        {
+            sizes[y * width + x] = map.isObstacle(x, y) ? 0 : -1;
+        }
+    }
+    for (int i = 0; i < snake.size(); i ++)
+    {
+        if (snake[i].getX() >= 0 && snake[i].getX() < width && snake[i].getY() >= 0 && snake[i].getY() < height)
+        {
+            sizes[snake[i].getY() * width + snake[i].getX()] = 0;
+        }
+    }
+    const int stepX[] = {0, 0, -1, 1};
+    const int stepY[] = {-1, 1, 0, 0};
+    for (int start = 0; start < width * height; start ++)
+    {
+        if (sizes[start] != -1)
+        {
+            continue;
+        }
+        queue.clear();
+        queue.push_back(start);
+        sizes[start] = -2;
+        for (int head = 0; head < queue.size(); head ++)
+        {
+            int x = queue[head] % width;
+            int y = queue[head] / width;
+            for (int i = 0; i < 4; i ++)
+            {
+                int nextX = x + stepX[i];
+                int nextY = y + stepY[i];
+                if (nextX >= 0 && nextX < width && nextY >= 0 && nextY < height && sizes[nextY * width + nextX] == -1)
+                {
+                    sizes[nextY * width + nextX] = -2;
+                    queue.push_back(nextY * width + nextX);
+                }
+            }
+        }
+        for (int cell : queue)
+        {
+            sizes[cell] = queue.size();
+        }
+    }
+}
+
+bool checkReachability(long long ticks, unsigned int seed)
+{
+    MapGenParams params;
+    params.movingObstacleNum = 4;
+    Engine engine(60, 24, params, 2);
+    engine.setSpaceTracking(true);
+    std::vector<int> sizes;
+    std::vector<int> queue;
+    long long played = 0;
+    long long failedTicks = 0;
+    int rounds = 0;
+    while (played < ticks)
+    {
+        engine.initializeRound(seed + rounds ++);
+        engine.spawnItems();
+        int points = 0;
+        long long lastMeal = 0;
+        while (played < ticks && !engine.isDead() && engine.getTickCount() - lastMeal < gStarvationTicks)
+        {
+            engine.getSnake().changeDirection(GreedyController::chooseDirection(engine));
+            engine.step(0);
+            played ++;
+            if (engine.getPoints() != points)
+            {
+                points = engine.getPoints();
+                lastMeal = engine.getTickCount();
+            }
+            if (engine.isDead())
+            {
+                break;
+            }
+            labelRegions(engine, sizes, queue);
+            const Reachability& reachability = engine.getReachability();
+            int width = engine.getMap().getWidth();
+            for (int cell = 0; cell < sizes.size(); cell ++)
+            {
+                if (reachability.getRegionSize(cell % width, cell / width) != sizes[cell])
+                {
+                    if (failedTicks ++ == 0)
+                    {
+                        std::cerr << "Round " << rounds << " tick " << engine.getTickCount() << ": cell (" << cell % width
+                            << ", " << cell / width << ") has " << reachability.getRegionSize(cell % width, cell / width)
+                            << " cells, the search found " << sizes[cell] << std::endl;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    std::cout << ticks << " ticks in " << rounds << " rounds, seed " << seed << ": " << failedTicks
+        << " ticks with region sizes off the search" << std::endl;
+    return failedTicks == 0;
+}
+
+// True when the planes hold the head and the body the slot describes
+static bool matchesPlanes(const ObservationClient& client, const ObservationSlot& slot)
+{
+    // A dead head may sit on a wall or on its own tail, nothing to hold it to
+    if (slot.dead)
+    {
+        return true;
+    }
+    const ObservationHeader& header = client.getHeader();
+    int cellNum = header.width * header.height;
+    const unsigned char* head = client.getPlane(PlaneHead);
+    const unsigned char* body = client.getPlane(PlaneBody);
+    if (slot.headX < 0 || slot.headX >= header.width || slot.headY < 0 || slot.headY >= header.height
+        || head[slot.headY * header.width + slot.headX] == 0)
+    {
+        return false;
+    }
+    int bodyCells = 0;
+    for (int i = 0; i < cellNum; i ++)
+    {
+        bodyCells += body[i] != 0;
+    }
+    return bodyCells == slot.length;
+}
+
+bool checkObservationRoundTrip(long long steps)
+{
+    std::string name = "/snake-check-" + std::to_string(getpid());
+    std::thread exporterThread([name]()
+    {
+        MapGenParams params;
+        Engine engine(40, 20, params, 2);
+        ObservationExporter exporter;
+        if (exporter.open(name, 40, 20, 64))
+        {
+            exporter.serve(engine, std::time(nullptr));
+        }
+    });
+
+    ObservationClient client;
+    Clock::time_point giveUp = Clock::now() + std::chrono::seconds(5);
+    bool opened;
+    while (!(opened = client.open(name)) && Clock::now() < giveUp)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!opened)
+    {
+        std::cerr << "The exporter did not create " << name << std::endl;
+        exporterThread.detach();
+        return false;
+    }
+
+    std::vector<double> roundTrips;
+    roundTrips.reserve(steps);
+    long long mismatches = 0;
+    int rounds = 1;
+    const ObservationSlot* slot = &client.waitForObservation();
+    for (long long i = 0; i < steps; i ++)
+    {
+        if (!matchesPlanes(client, *slot))
+        {
+            mismatches ++;
+        }
+        rounds += slot->dead;
+        // Keeps the heading, the exporter still steps and patches the planes
+        Clock::time_point before = Clock::now();
+        client.answer(static_cast<int>(Direction::Right) + 1);
+        slot = &client.waitForObservation();
+        roundTrips.push_back(std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+    }
+    client.answer(-1);
+    exporterThread.join();
+    client.close();
+
+    std::sort(roundTrips.begin(), roundTrips.end());
+    double total = 0;
+    for (double roundTrip : roundTrips)
+    {
+        total += roundTrip;
+    }
+    std::cout << std::fixed << std::setprecision(1) << steps << " steps in " << rounds << " rounds, round trip "
+        << total / steps << " us mean, " << roundTrips[steps / 2] << " us median, "
+        << roundTrips[steps * 99 / 100] << " us p99: " << mismatches << " observations off their planes" << std::endl;
+    return mismatches == 0;
+}
+
+// Centers the engine's view on the head, food lands inside it
+static void followHead(Engine& engine)
+{
+    const SnakeBody& head = engine.getSnake().getSnake()[0];
+    engine.setView(head.getX() - gViewWidth / 2, head.getY() - gViewHeight / 2, gViewWidth, gViewHeight);
+}
+
+bool checkWorld(int width, int height, long long ticks, unsigned int seed)
+{
+    MapGenParams params;
+    Engine engine(gViewWidth, gViewHeight, params, 2);
+    engine.initializeWorld(width, height, seed);
+    if (engine.getMap().getWidth() != width || engine.getMap().getHeight() != height)
+    {
+        std::cerr << "Asked for a " << width << " by " << height << " world, got " << engine.getMap().getWidth()
+            << " by " << engine.getMap().getHeight() << std::endl;
+        return false;
+    }
+    engine.initializeRound(seed);
+    followHead(engine);
+    engine.spawnItems();
+    long long played = 0;
+    while (played < ticks && !engine.isDead())
+    {
+        engine.getSnake().changeDirection(GreedyController::chooseDirection(engine));
+        engine.step(0);
+        played ++;
+        followHead(engine);
+    }
+
+    // The cells go to disk and back as packed words
+    std::vector<unsigned char> buffer;
+    engine.saveSnapshot(buffer);
+    char path[] = "/tmp/snake-world-XXXXXX";
+    int file = mkstemp(path);
+    Engine resumed(gViewWidth, gViewHeight, params, 2);
+    resumed.initializeWorld(width, height, seed);
+    SnapshotFile snapshot;
+    bool restored = file >= 0 && close(file) == 0 && SnapshotFile::write(path, buffer) && snapshot.open(path)
+        && resumed.loadSnapshot(snapshot);
+    snapshot.close();
+    unlink(path);
+    const BodyRing& body = engine.getSnake().getSnake();
+    const BodyRing& resumedBody = resumed.getSnake().getSnake();
+    bool same = restored && body.size() == resumedBody.size() && engine.getFood() == resumed.getFood();
+    for (int i = 0; same && i < body.size(); i ++)
+    {
+        same = body[i] == resumedBody[i];
+    }
+
+    std::cout << width << " by " << height << " world, seed " << seed << ": " << played << " ticks, "
+        << engine.getPoints() << " points, head at (" << body[0].getX() << ", " << body[0].getY() << "), "
+        << (!restored ? "snapshot not restored" : (same ? "snapshot restored" : "snapshot differs")) << std::endl;
+    return same;
+}
+
+// One process of the shared leaderboard check. Every entry it inserts
+// carries a seed unique to the check, the seeds whose insert returned
+// true are appended to the results file.
+static void insertUntilKilled(const std::string& path, int capacity, int process, int results)
+{
+    SharedLeaderboard board;
+    if (!board.open(path, capacity, ""))
+    {
+        _exit(1);
+    }
+    std::vector<LeaderboardEntry> top(capacity);
+    for (int i = 0; i < gSharedInserts; i ++)
+    {
+        uint32_t seed = process * gSharedInserts + i;
+        LeaderboardEntry entry = Leaderboard::makeEntry("check", int(seed * 2654435761u % 100000), 0, seed);
+        if (board.insert(entry))
+        {
+            ssize_t written = write(results, &seed, sizeof(seed));
+            (void)written;
+        }
+        // Holds the mutex for a copy of the whole table, so most kills land
+        // while it is held
+        board.copyTop(top.data(), capacity);
+    }
+    _exit(0);
+}
+
+bool checkSharedLeaderboard(int processes, int rounds, unsigned int seed)
+{
+    char directory[] = "/tmp/snake-check-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        std::cerr << "Cannot create a scratch directory" << std::endl;
+        return false;
+    }
+    std::string path = std::string(directory) + "/record.shm";
+    std::string resultsPath = std::string(directory) + "/inserted";
+    // Room for every entry, nothing is evicted and every reported insert must stay
+    int capacity = processes * rounds * gSharedInserts;
+    SharedLeaderboard board;
+    int results = ::open(resultsPath.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (results < 0 || !board.open(path, capacity, ""))
+    {
+        std::cerr << "Cannot open the shared leaderboard" << std::endl;
+        return false;
+    }
+    // A mutex left held and never recovered hangs every locker, end the check instead
+    alarm(300);
+    std::mt19937 random(seed);
+    int killed = 0;
+    for (int round = 0; round < rounds; round ++)
+    {
+        std::vector<pid_t> children;
+        for (int i = 0; i < processes; i ++)
+        {
+            pid_t child = fork();
+            if (child == 0)
+            {
+                insertUntilKilled(path, capacity, round * processes + i, results);
+            }
+            children.push_back(child);
+        }
+        usleep(500 + random() % 3000);
+        for (int i = 0; i < gSharedKills && i < children.size(); i ++)
+        {
+            kill(children[i], SIGKILL);
+        }
+        for (int i = 0; i < children.size(); i ++)
+        {
+            int status = 0;
+            waitpid(children[i], &status, 0);
+            killed += WIFSIGNALED(status) ? 1 : 0;
+        }
+    }
+    alarm(0);
+
+    std::vector<LeaderboardEntry> top(capacity);
+    int count = board.copyTop(top.data(), capacity);
+    std::vector<int> seen(capacity, 0);
+    int unordered = 0;
+    int duplicated = 0;
+    int lost = 0;
+    for (int i = 0; i < count; i ++)
+    {
+        unordered += i > 0 && LeaderboardOrder()(top[i], top[i - 1]) ? 1 : 0;
+        // A seed outside the check's range is a torn entry
+        if (top[i].seed >= (uint32_t)capacity || seen[top[i].seed] ++ > 0)
+        {
+            duplicated ++;
+        }
+    }
+    uint32_t inserted;
+    lseek(results, 0, SEEK_SET);
+    while (read(results, &inserted, sizeof(inserted)) == sizeof(inserted))
+    {
+        lost += inserted >= (uint32_t)capacity || seen[inserted] == 0 ? 1 : 0;
+    }
+    int repairs = board.getRepairCount();
+    board.close();
+    ::close(results);
+    unlink(path.c_str());
+    unlink(resultsPath.c_str());
+    rmdir(directory);
+
+    std::cout << rounds << " rounds of " << processes << " processes, seed " << seed << ", " << killed << " killed, "
+        << repairs << " repairs after a dead holder: " << count << " entries, " << unordered << " out of order, "
+        << duplicated << " duplicated or torn, " << lost << " lost" << std::endl;
+    return unordered == 0 && duplicated == 0 && lost == 0 && repairs > 0;
+}
@@ -0,0 +1,37 @@
+#ifndef SELFCHECK_H
+#define SELFCHECK_H
+
+// Headless checks of what the game promises, for a build or a CI job
+// to run. Each prints what it saw and returns false once the promise is
+// broken.
+
+// Plays full rounds, drawing included, on a curses screen that writes to
+// /dev/null, and fails when any tick after the warm-up allocates. The
+// counter only runs in a build with -DSNAKE_COUNT_ALLOCATIONS, without it
+// the check fails as well.
+bool checkTickAllocations(long long ticks);
+
+// Plays rounds with space tracking on and, after every tick, labels the
+// board again with a plain breadth first search. Fails on any cell whose
+// region size differs from the incremental labels.
+bool checkReachability(long long ticks, unsigned int seed);
+
+// Runs the observation exporter on a thread and answers it from this one
+// through the shared segment, the way a trainer would. Fails when an
+// observation disagrees with its own planes, and prints the time from an
+// answer to the next observation.
+bool checkObservationRoundTrip(long long steps);
+
+// Plays a round on a world of the given size, moving the view along with
+// the head the way the camera does, then saves and resumes it. Fails when
+// the world came out of another size or the resumed round differs.
+bool checkWorld(int width, int height, long long ticks, unsigned int seed);
+
+// Runs rounds of processes inserting into one shared leaderboard and
+// SIGKILLs some of each round while they work, most of them holding its
+// mutex. Fails when the table ends up out of order, with a duplicate or
+// without an entry whose insert returned true, or when no dead holder
+// was ever recovered from.
+bool checkSharedLeaderboard(int processes, int rounds, unsigned int seed);
+
+#endif
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+// For the shared mapping and its mutex
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sharedleaderboard.h"
+#include "checksum.h"
+
+struct SharedLeaderboardSlot
+{
+    LeaderboardEntry entry;
+    uint32_t checksum;
+    uint32_t padding;
+};
+
+struct SharedLeaderboardHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t capacity;
+    uint32_t count;
+    // A mutex left held by a machine that went down would never be
+    // released, the first process after a boot sets it up again
+    char bootId[40];
+    std::atomic<uint64_t> generation;
+    // The entry an insert is placing, set while its slots move
+    uint32_t pendingValid;
+    // Tables rebuilt after their mutex was left by a dead process
+    uint32_t repairs;
+    SharedLeaderboardSlot pending;
+    pthread_mutex_t mutex;
+};
+
+static const char gSharedMagic[8] = {'S', 'N', 'K', 'S', 'H', 'A', 'R', 'E'};
+static const uint32_t gSharedVersion = 1;
+// How long a locker sleeps before it looks at the mutex again
+static const long gLockRetryNanoseconds = 50 * 1000000L;
+
+static SharedLeaderboardSlot makeSlot(const LeaderboardEntry& entry)
+{
+    SharedLeaderboardSlot slot = {};
+    slot.entry = entry;
+    slot.checksum = crc32(&slot.entry, sizeof(slot.entry));
+    return slot;
+}
+
+static bool isIntact(const SharedLeaderboardSlot& slot)
+{
+    return slot.entry.timestamp != 0 && slot.checksum == crc32(&slot.entry, sizeof(slot.entry));
+}
+
+static bool isSameEntry(const LeaderboardEntry& a, const LeaderboardEntry& b)
+{
+    return std::memcmp(&a, &b, sizeof(LeaderboardEntry)) == 0;
+}
+
+static std::string readBootId()
+{
+    char id[40] = {};
+    int fd = ::open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+    if (fd >= 0)
+    {
+        ssize_t got = ::read(fd, id, sizeof(id) - 1);
+        ::close(fd);
+        id[got > 0 ? got : 0] = '\0';
+    }
+    return std::string(id, std::strcspn(id, "\n"));
+}
+
+SharedLeaderboard::SharedLeaderboard(): mHeader(nullptr), mSlots(nullptr), mSize(0)
+{
+}
+
+SharedLeaderboard::~SharedLeaderboard()
+{
+    this->close();
+}
+
+bool SharedLeaderboard::open(const std::string& path, int capacity, const std::string& importPath)
+{
+    this->close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    // Held while the file is checked and set up, no two processes create it
+    if (flock(fd, LOCK_EX) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    bool valid = false;
+    alignas(SharedLeaderboardHeader) unsigned char bytes[sizeof(SharedLeaderboardHeader)];
+    if (ok && info.st_size >= (off_t)sizeof(bytes) && ::pread(fd, bytes, sizeof(bytes), 0) == sizeof(bytes))
+    {
+        const SharedLeaderboardHeader* header = reinterpret_cast<const SharedLeaderboardHeader*>(bytes);
+        valid = std::memcmp(header->magic, gSharedMagic, sizeof(gSharedMagic)) == 0
+            && header->version == gSharedVersion && header->entrySize == sizeof(LeaderboardEntry)
+            && header->capacity > 0 && header->count <= header->capacity
+            && info.st_size == (off_t)(sizeof(SharedLeaderboardHeader) + header->capacity * sizeof(SharedLeaderboardSlot));
+        // A board created with another capacity keeps its own
+        capacity = valid ? header->capacity : capacity;
+    }
+    this->mSize = sizeof(SharedLeaderboardHeader) + capacity * sizeof(SharedLeaderboardSlot);
+    // A new or damaged file starts over, zeroed
+    if (ok && !valid)
+    {
+        ok = ftruncate(fd, 0) == 0 && ftruncate(fd, this->mSize) == 0;
+    }
+    void* data = ok ? mmap(nullptr, this->mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED)
+    {
+        flock(fd, LOCK_UN);
+        ::close(fd);
+        this->mSize = 0;
+        return false;
+    }
+    this->mHeader = static_cast<SharedLeaderboardHeader*>(data);
+    this->mSlots = reinterpret_cast<SharedLeaderboardSlot*>(this->mHeader + 1);
+
+    std::string bootId = readBootId();
+    if (!valid)
+    {
+        this->initialize(capacity, bootId);
+        // Scores of the log the game used to keep, ignored if it has none
+        Leaderboard log(importPath, capacity);
+        if (log.load())
+        {
+            const std::multiset<LeaderboardEntry, LeaderboardOrder>& entries = log.getEntries();
+            for (std::multiset<LeaderboardEntry, LeaderboardOrder>::const_iterator it = entries.begin(); it != entries.end(); ++ it)
+            {
+                this->insert(*it);
+            }
+        }
+        // Valid only once it is complete
+        std::memcpy(this->mHeader->magic, gSharedMagic, sizeof(gSharedMagic));
+    }
+    else if (bootId != this->mHeader->bootId)
+    {
+        // Nobody from before the boot still holds the mutex
+        this->initialize(capacity, bootId);
+        this->repair();
+        std::memcpy(this->mHeader->magic, gSharedMagic, sizeof(gSharedMagic));
+    }
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    return true;
+}
+
+void SharedLeaderboard::initialize(int capacity, const std::string& bootId)
+{
+    SharedLeaderboardHeader* header = this->mHeader;
+    std::memset(header->magic, 0, sizeof(header->magic));
+    header->version = gSharedVersion;
+    header->entrySize = sizeof(LeaderboardEntry);
+    header->capacity = capacity;
+    std::memset(header->bootId, 0, sizeof(header->bootId));
+    std::strncpy(header->bootId, bootId.c_str(), sizeof(header->bootId) - 1);
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+void SharedLeaderboard::close()
+{
+    if (this->mHeader != nullptr)
+    {
+        munmap(this->mHeader, this->mSize);
+    }
+    this->mHeader = nullptr;
+    this->mSlots = nullptr;
+    this->mSize = 0;
+}
+
+bool SharedLeaderboard::isOpen() const
+{
+    return this->mHeader != nullptr;
+}
+
+bool SharedLeaderboard::lock() const
+{
+    // A waiter killed right after its wake-up takes the wake-up along, and
+    // once the holder has taken the mutex again the others would sleep on
+    // for good. A wait that times out finds a dead holder on the next try.
+    int result = ETIMEDOUT;
+    while (result == ETIMEDOUT)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += gLockRetryNanoseconds;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        result = pthread_mutex_timedlock(&this->mHeader->mutex, &deadline);
+    }
+    if (result == EOWNERDEAD)
+    {
+        this->repair();
+        this->mHeader->repairs ++;
+        pthread_mutex_consistent(&this->mHeader->mutex);
+        return true;
+    }
+    return result == 0;
+}
+
+void SharedLeaderboard::unlock() const
+{
+    pthread_mutex_unlock(&this->mHeader->mutex);
+}
+
+void SharedLeaderboard::repair() const
+{
+    SharedLeaderboardHeader* header = this->mHeader;
+    // The slot past the count may hold the last entry mid-shift
+    int scanned = std::min<int>(header->count + 1, header->capacity);
+    std::vector<LeaderboardEntry> entries;
+    entries.reserve(scanned + 1);
+    for (int i = 0; i < scanned; i ++)
+    {
+        if (isIntact(this->mSlots[i]))
+        {
+            entries.push_back(this->mSlots[i].entry);
+        }
+    }
+    if (header->pendingValid && isIntact(header->pending))
+    {
+        entries.push_back(header->pending.entry);
+    }
+    std::stable_sort(entries.begin(), entries.end(), LeaderboardOrder());
+    entries.erase(std::unique(entries.begin(), entries.end(), isSameEntry), entries.end());
+    int count = std::min<int>(entries.size(), header->capacity);
+    for (int i = 0; i < count; i ++)
+    {
+        this->mSlots[i] = makeSlot(entries[i]);
+    }
+    for (int i = count; i < scanned; i ++)
+    {
+        std::memset(&this->mSlots[i], 0, sizeof(SharedLeaderboardSlot));
+    }
+    header->count = count;
+    header->pendingValid = 0;
+    header->generation.fetch_add(1, std::memory_order_release);
+}
+
+bool SharedLeaderboard::insert(const LeaderboardEntry& entry)
+{
+    if (this->mHeader == nullptr || !this->lock())
+    {
+        return false;
+    }
+    SharedLeaderboardHeader* header = this->mHeader;
+    int count = header->count;
+    // Past the entries that rank above or tie with it
+    int position = std::upper_bound(this->mSlots, this->mSlots + count, entry,
+        [](const LeaderboardEntry& a, const SharedLeaderboardSlot& b) { return LeaderboardOrder()(a, b.entry); })
+        - this->mSlots;
+    bool present = false;
+    for (int i = position - 1; i >= 0 && !LeaderboardOrder()(this->mSlots[i].entry, entry); i --)
+    {
+        present = present || isSameEntry(this->mSlots[i].entry, entry);
+    }
+    if (present || position >= (int)header->capacity)
+    {
+        this->unlock();
+        return false;
+    }
+    header->pending = makeSlot(entry);
+    header->pendingValid = 1;
+    // The worse entries move down one slot each, from the bottom up, so a
+    // holder killed midway leaves every entry whole in its old or its new
+    // slot; memmove gives no such order. That is O(capacity) rather than
+    // O(log capacity), at most tens of KB for the game's table and once
+    // per round. A linked or tree layout would need its own allocator in
+    // the mapping and a repair that can follow torn links.
+    int last = std::min<int>(count, header->capacity - 1);
+    for (int i = last; i > position; i --)
+    {
+        this->mSlots[i] = this->mSlots[i - 1];
+        // Keeps the compiler from merging the copies into a memmove
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    this->mSlots[position] = header->pending;
+    header->count = std::min<int>(count + 1, header->capacity);
+    header->pendingValid = 0;
+    header->generation.fetch_add(1, std::memory_order_release);
+    this->unlock();
+    return true;
+}
+
+int SharedLeaderboard::copyTop(LeaderboardEntry* entries, int maxNum) const
+{
+    if (this->mHeader == nullptr || !this->lock())
+    {
+        return 0;
+    }
+    int num = std::min<int>(maxNum, this->mHeader->count);
+    for (int i = 0; i < num; i ++)
+    {
+        entries[i] = this->mSlots[i].entry;
+    }
+    this->unlock();
+    return num;
+}
+
+uint64_t SharedLeaderboard::getGeneration() const
+{
+    return this->mHeader == nullptr ? 0 : this->mHeader->generation.load(std::memory_order_acquire);
+}
+
+int SharedLeaderboard::getCapacity() const
+{
+    return this->mHeader == nullptr ? 0 : this->mHeader->capacity;
+}
+
+int SharedLeaderboard::getRepairCount() const
+{
+    return this->mHeader == nullptr ? 0 : this->mHeader->repairs;
+}
+
+bool SharedLeaderboard::sync()
+{
+    return this->mHeader != nullptr && msync(this->mHeader, this->mSize, MS_SYNC) == 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SHAREDLEADERBOARD_H
+#define SHAREDLEADERBOARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "leaderboard.h"
+
+struct SharedLeaderboardHeader;
+struct SharedLeaderboardSlot;
+
+/*
+ * The leaderboard of every game process on the host, a file all of them
+ * map shared:
+ *   SharedLeaderboardHeader, holding a robust process-shared mutex
+ *   capacity slots, the entries best first, each with its CRC-32
+ * An insert takes the mutex, shifts the worse entries down one slot and
+ * bumps the generation, so the other processes see it on their next
+ * read without opening the file again. A process that dies holding the
+ * mutex leaves at worst one slot duplicated or torn; the next one to
+ * lock it rebuilds the table from the slots that pass their checksum
+ * and the entry being inserted, which is parked in the header first.
+ * Everything lives in the page cache, so the board outlives any process;
+ * sync() puts it on disk for the machine going down.
+ */
+class SharedLeaderboard
+{
+public:
+    SharedLeaderboard();
+    ~SharedLeaderboard();
+    SharedLeaderboard(const SharedLeaderboard&) = delete;
+    SharedLeaderboard& operator = (const SharedLeaderboard&) = delete;
+
+    // Maps the board, creating it with the entries of the log at
+    // importPath when there is none yet
+    bool open(const std::string& path, int capacity, const std::string& importPath);
+    void close();
+    bool isOpen() const;
+    // False when the entry does not make the table or is already in it
+    bool insert(const LeaderboardEntry& entry);
+    // Copies up to maxNum entries from the top, the number copied
+    int copyTop(LeaderboardEntry* entries, int maxNum) const;
+    // Changes with every insert, from any process
+    uint64_t getGeneration() const;
+    int getCapacity() const;
+    // How often a process found the mutex left by a dead holder and
+    // rebuilt the table, over the life of the file
+    int getRepairCount() const;
+    // Writes the mapped table back to the file
+    bool sync();
+
+private:
+    bool lock() const;
+    void unlock() const;
+    // Rebuilds the table after a holder of the mutex died mid-insert
+    void repair() const;
+    void initialize(int capacity, const std::string& bootId);
+
+    SharedLeaderboardHeader* mHeader;
+    SharedLeaderboardSlot* mSlots;
+    std::size_t mSize;
+};
+
+#endif
@@ -2,45 +2,154 @@
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <algorithm>
 
 #include "snake.h"
+#include "map.h"
 
 
-SnakeBody::SnakeBody()
+SnakeBody::SnakeBody(): mCell(0)
 {
 }
 
 
-SnakeBody::SnakeBody(int x, int y): mX(x), mY(y)
+SnakeBody::SnakeBody(int x, int y): mCell(uint64_t(uint32_t(x)) | (uint64_t(uint32_t(y)) << 32))
 {
 }
 
 int SnakeBody::getX() const
 {
-    return mX;
+    return int32_t(uint32_t(mCell));
 }
 
 int SnakeBody::getY() const
 {
-    return mY;
+    return int32_t(mCell >> 32);
 }
 
-bool SnakeBody::operator == (const SnakeBody& snakeBody)
+uint64_t SnakeBody::getPacked() const
+{
+    return mCell;
+}
+
+SnakeBody SnakeBody::fromPacked(uint64_t cell)
+{
+    SnakeBody snakeBody;
+    snakeBody.mCell = cell;
+    return snakeBody;
+}
+
+bool SnakeBody::operator == (const SnakeBody& snakeBody) const
 {
 		// TODO overload the == operator for SnakeBody comparision.
-    if (mX == snakeBody.getX()
-        && mY == snakeBody.getY())
-        return true;
+    return mCell == snakeBody.mCell;
+}
 
-    return false;
+bool SnakeBody::operator != (const SnakeBody& snakeBody) const
+{
+    return mCell != snakeBody.mCell;
+}
+
+BodyRing::BodyRing() : mMask(-1), mHead(0), mSize(0)
+{
+}
+
+void BodyRing::reserve(int capacity)
+{
+    int size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    if (size <= this->mMask + 1)
+    {
+        return;
+    }
+    // Unroll the ring into the new storage, head first
+    std::vector<SnakeBody> cells(size);
+    for (int i = 0; i < this->mSize; i ++)
+    {
+        cells[i] = (*this)[i];
+    }
+    this->mCells.swap(cells);
+    this->mMask = size - 1;
+    this->mHead = 0;
+}
+
+void BodyRing::clear()
+{
+    this->mHead = 0;
+    this->mSize = 0;
+}
+
+void BodyRing::pushFront(const SnakeBody& cell)
+{
+    if (this->mSize == this->mMask + 1)
+    {
+        this->reserve(this->mSize * 2);
+    }
+    this->mHead = (this->mHead - 1) & this->mMask;
+    this->mCells[this->mHead] = cell;
+    this->mSize ++;
+}
+
+void BodyRing::popBack()
+{
+    this->mSize --;
+}
+
+const SnakeBody& BodyRing::operator [] (int index) const
+{
+    return this->mCells[(this->mHead + index) & this->mMask];
+}
+
+int BodyRing::find(const SnakeBody& cell) const
+{
+    for (int i = 0; i < this->mSize; i ++)
+    {
+        if ((*this)[i] == cell)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int BodyRing::size() const
+{
+    return this->mSize;
+}
+
+bool BodyRing::empty() const
+{
+    return this->mSize == 0;
 }
 
-Snake::Snake(int gameBoardWidth, int gameBoardHeight, int initialSnakeLength): mGameBoardWidth(gameBoardWidth), mGameBoardHeight(gameBoardHeight), mInitialSnakeLength(initialSnakeLength)
+std::size_t BodyRing::getMemoryUsage() const
 {
+    return this->mCells.capacity() * sizeof(SnakeBody);
+}
+
+Snake::Snake(int gameBoardWidth, int gameBoardHeight, int initialSnakeLength): mGameBoardWidth(gameBoardWidth), mGameBoardHeight(gameBoardHeight), mInitialSnakeLength(initialSnakeLength),
+    mSpawnX(gameBoardWidth / 2), mSpawnY(gameBoardHeight / 2), mMap(nullptr), mPendingGrowth(0), mGhost(false)
+{
+    // The snake can never be longer than the board, plus the new head
+    // inserted before the tail is dropped. Reserving that once means
+    // moving and growing never reallocate during a round on terminal
+    // sized boards; huge levels cap the reserve.
+    this->mSnake.reserve(std::min((long long)this->mGameBoardWidth * this->mGameBoardHeight + 1, (long long)this->mMaxReservedLength));
     this->initializeSnake();
     this->setRandomSeed();
 }
 
+void Snake::resizeBoard(int gameBoardWidth, int gameBoardHeight)
+{
+    this->mGameBoardWidth = gameBoardWidth;
+    this->mGameBoardHeight = gameBoardHeight;
+    // Only grows the reserve when the board got bigger than ever before
+    this->mSnake.reserve(std::min((long long)this->mGameBoardWidth * this->mGameBoardHeight + 1, (long long)this->mMaxReservedLength));
+}
+
 void Snake::setRandomSeed()
 {
     // use current time as seed for random generator
@@ -53,126 +162,86 @@ void Snake::initializeSnake()
     // We always put the snake at the center of the game mWindows
     //int centerX = 1;
     //int centerY = 0;
-    int centerX = this->mGameBoardWidth / 2;
-    int centerY = this->mGameBoardHeight / 2;
+    int centerX = this->mSpawnX;
+    int centerY = this->mSpawnY;
 
-    for (int i = 0; i < this->mInitialSnakeLength; i ++)
+    // Called again on restart, clear() keeps the reserved capacity
+    this->mSnake.clear();
+    for (int i = this->mInitialSnakeLength - 1; i >= 0; i --)
     {
-        this->mSnake.push_back(SnakeBody(centerX, centerY + i));
+        this->mSnake.pushFront(SnakeBody(centerX, centerY + i));
+        this->markCell(this->mSnake[0], true);
     }
     this->mDirection = Direction::Up;
+    this->mPendingGrowth = 0;
+    this->mGhost = false;
 }
 
-bool Snake::isPartOfSnake(int x, int y)
+void Snake::shrink(int segments, SnakeStep& step)
 {
-		// TODO check if a given point with axis x, y is on the body of the snake.
-    for (int i = 1; i < this->mSnake.size(); i++) {
-        if (x == this->mSnake[i].getX() && y == this->mSnake[i].getY())
-            return true;
+    while (segments > 0 && this->mSnake.size() > 2 && step.freedNum < SnakeStep::kMaxFreed)
+    {
+        step.freed[step.freedNum] = this->mSnake[this->mSnake.size() - 1];
+        this->markCell(step.freed[step.freedNum], false);
+        this->mSnake.popBack();
+        step.freedNum ++;
+        segments --;
     }
+}
 
-    return false;
+void Snake::setGhost(bool ghost)
+{
+    this->mGhost = ghost;
 }
 
-/*
- * Assumption:
- * Only the head would hit wall.
- */
-bool Snake::hitWall()
+bool Snake::isGhost() const
 {
-		// TODO check if the snake has hit the wall
-    SnakeBody head = this->mSnake[0];
-    int x = head.getX(), y = head.getY();
-    if (x == 1 || x == this->mGameBoardWidth-1
-        || y == 0 || y == this->mGameBoardHeight-1)
-        return true;
-    return false;
+    return this->mGhost;
 }
 
-/*
- * The snake head is overlapping with its body
- */
-bool Snake::hitSelf()
+int Snake::getPendingGrowth() const
 {
-		// TODO check if the snake has hit itself.
-    SnakeBody head = this->mSnake[0];
-    int x = head.getX(), y = head.getY();
+    return this->mPendingGrowth;
+}
 
- /*   switch (this->mDirection)
+void Snake::restore(const uint64_t* cells, int length, Direction direction, int pendingGrowth, bool ghost)
+{
+    this->mSnake.clear();
+    this->mSnake.reserve(length + 1);
+    // Pushed tail first so the head ends up at index 0
+    for (int i = length - 1; i >= 0; i --)
     {
-        case Direction::Up:
-        {
-            y--;
-            break;
-
-        }
-        case Direction::Down:
-        {
-            y++;
-            break;
-        }
-        case Direction::Left:
-        {
-            x--;
-            break;
-
-        }
-        case Direction::Right:
-        {
-            x++;
-            break;
-
-        }
+        this->mSnake.pushFront(SnakeBody::fromPacked(cells[i]));
+        this->markCell(this->mSnake[0], true);
     }
-    */
-    if (this->isPartOfSnake(x, y))
-        return true;
-
-    return false;
+    this->mDirection = direction;
+    this->mPendingGrowth = pendingGrowth;
+    this->mGhost = ghost;
 }
 
-
-bool Snake::touchFood()
+void Snake::setSpawnPoint(int x, int y)
 {
-    SnakeBody newHead = this->createNewHead();
-    if (this->mFood == newHead)
-    {
-        return true;
-    }
-    else
-    {
-        return false;
-    }
+    this->mSpawnX = x;
+    this->mSpawnY = y;
 }
 
-bool Snake::obstacleSurviveCheck(int key)
+bool Snake::isPartOfSnake(int x, int y)
 {
-    if (key == 'g' || key == 'G')
-        return true;
-    else
+		// TODO check if a given point with axis x, y is on the body of the snake.
+    if (!this->mSnake.empty() && x == this->mSnake[0].getX() && y == this->mSnake[0].getY())
         return false;
+    // One bit in the map's snake layer instead of a scan of the body
+    if (this->mMap != nullptr)
+        return this->mMap->getCell(x, y) & CellSnake;
+    return this->mSnake.find(SnakeBody(x, y)) > 0;
 }
-int Snake::touchObstacle(int key)
-{
-    SnakeBody newHead = this->newHead();
 
-    for (int i = 0; i < this->mObstacle.size(); i++) {
-        if (this->mObstacle[i] == newHead) {
-            if (this->obstacleSurviveCheck(key))
-                return 1;
-            else
-                return 2;
-        }
-    }
-
-    return 0;
-   /* if (!(this->mObstacle == newHead)) {
-        return 0; //not meet the obstacle
-    }
-    else if (this->obstacleSurviveCheck(key)) {
-        return 1; //survive
+void Snake::markCell(const SnakeBody& cell, bool set)
+{
+    if (this->mMap != nullptr)
+    {
+        this->mMap->setSnakeCell(cell.getX(), cell.getY(), set);
     }
-    else return 2; // dead*/
 }
 
 void Snake::senseFood(SnakeBody food)
@@ -180,11 +249,12 @@ void Snake::senseFood(SnakeBody food)
     this->mFood = food;
 }
 
-void Snake::senseObstacle(SnakeBody obstacle)
+void Snake::senseMap(Map* map)
 {
-    this->mObstacle.push_back(obstacle);
+    this->mMap = map;
 }
-std::vector<SnakeBody>& Snake::getSnake()
+
+const BodyRing& Snake::getSnake() const
 {
     return this->mSnake;
 }
@@ -247,6 +317,11 @@ bool Snake::changeDirection(Direction newDirection)
 
     return false;
 }
+Direction Snake::getDirection() const
+{
+    return this->mDirection;
+}
+
 SnakeBody Snake::newHead()
 {
     SnakeBody head = this->mSnake[0];
@@ -282,95 +357,116 @@ SnakeBody Snake::newHead()
     return newHead;
 }
 
-SnakeBody Snake::createNewHead()
+bool Snake::isDeath(StepResult result)
 {
-		/* TODO
-		 * read the position of the current head
-		 * read the current heading direction
-		 * add the new head according to the direction
-		 * return the new snake
-		 */
-    SnakeBody head = this->mSnake[0];
-    int x = head.getX(), y = head.getY();
-
-    switch (this->mDirection)
-    {
-        case Direction::Up:
-        {
-            y--;
-            break;
-
-        }
-        case Direction::Down:
-        {
-            y++;
-            break;
-        }
-        case Direction::Left:
-        {
-            x--;
-            break;
-
-        }
-        case Direction::Right:
-        {
-            x++;
-            break;
-
-        }
-    }
-    this->mSnake.insert(this->mSnake.begin(),SnakeBody(x, y));
-    //this->mSnake.pop_back();
-
-
-    SnakeBody newHead = this->mSnake[0];
-    return newHead;
+    return result == StepResult::ObstacleFatal || result == StepResult::HitWall || result == StepResult::HitSelf;
 }
 
-/*
- * If eat food, return true, otherwise return false
- */
-int Snake::moveFoward(int key)
+template <class Rules>
+SnakeStep Snake::step(int key)
 {
-    /*
-		 * TODO
-		 * move the snake forward.
-     * If eat food, return true, otherwise return false
-     */
-
-    if (this->touchFood())
-        return 0;
-    else if (this->touchObstacle(key) == 1) {
-        this->mSnake.pop_back();
-        this->mSnake.pop_back();
-        return 1;
+    typedef typename Rules::ObstaclePolicy Obstacles;
+    const int growth = Rules::GrowthPolicy::kSegments;
+    SnakeStep step;
+    SnakeBody next = this->newHead();
+    int x = next.getX();
+    int y = next.getY();
+    Rules::WallPolicy::apply(x, y, this->mGameBoardWidth, this->mGameBoardHeight);
+    step.head = SnakeBody(x, y);
+    step.freedNum = 0;
+    const SnakeBody& tail = this->mSnake[this->mSnake.size() - 1];
+    bool food = step.head == this->mFood;
+    // Still growing from earlier food, the tail stays where it is
+    bool growing = food || (growth > 1 && this->mPendingGrowth > 0);
+    // Walls, obstacles and the body come out of one lookup
+    unsigned char cell = 0;
+    if (this->mMap != nullptr)
+    {
+        cell = this->mMap->getCell(x, y);
     }
-    else {
-        //this->createNewHead();
-        this->mSnake.pop_back();
-        return 2;
+    else if (x <= 1 || x >= this->mGameBoardWidth - 1 || y <= 0 || y >= this->mGameBoardHeight - 1)
+    {
+        cell = CellWall;
+    }
+    if (cell & CellWall)
+    {
+        step.result = StepResult::HitWall;
+    }
+    // The tail moves out of the way unless the snake grows
+    else if ((cell & CellSnake) && (growing || step.head != tail))
+    {
+        step.result = StepResult::HitSelf;
+    }
+    else if ((cell & CellObstacle) && !this->mGhost)
+    {
+        // Surviving costs a segment, the last one cannot be given up
+        bool survive = Obstacles::survives(key, this->mSnake.size());
+        step.result = survive ? StepResult::ObstacleSurvived : StepResult::ObstacleFatal;
+    }
+    else
+    {
+        step.result = food ? StepResult::Ate : StepResult::Moved;
+    }
+    if (isDeath(step.result))
+    {
+        return step;
     }
 
-
+    // The tail leaves before the head arrives, the head may take its cell
+    int drop = (growing ? 0 : 1) + (step.result == StepResult::ObstacleSurvived ? Obstacles::kPenalty : 0);
+    if (growth > 1)
+    {
+        // A food's other segments are added on the moves after it
+        this->mPendingGrowth += food ? growth - 1 : (growing ? -1 : 0);
+    }
+    for (int i = 0; i < drop; i ++)
+    {
+        step.freed[i] = this->mSnake[this->mSnake.size() - 1];
+        this->markCell(step.freed[i], false);
+        this->mSnake.popBack();
+    }
+    step.freedNum = drop;
+    this->mSnake.pushFront(step.head);
+    this->markCell(step.head, true);
+    next = this->newHead();
+    x = next.getX();
+    y = next.getY();
+    Rules::WallPolicy::apply(x, y, this->mGameBoardWidth, this->mGameBoardHeight);
+    step.ahead = SnakeBody(x, y);
+    return step;
 }
 
-bool Snake::checkCollision()
+template <class Walls, class Obstacles>
+Snake::StepFunction Snake::selectGrowth(int growth)
 {
-    if (this->hitWall() || this->hitSelf())
+    switch (growth)
     {
-        return true;
+        case 2:
+            return &Snake::step<RuleSet<Walls, Obstacles, Growth<2> > >;
+        case 3:
+            return &Snake::step<RuleSet<Walls, Obstacles, Growth<3> > >;
+        default:
+            return &Snake::step<RuleSet<Walls, Obstacles, Growth<1> > >;
     }
-    else
+}
+
+template <class Walls>
+Snake::StepFunction Snake::selectObstacles(const RuleParams& rules)
+{
+    if (rules.obstacles == ObstacleRule::Fatal)
     {
-        return false;
+        return selectGrowth<Walls, FatalObstacles>(rules.growth);
     }
+    return selectGrowth<Walls, SurviveOnKey>(rules.growth);
 }
 
-bool Snake::checkDeath(int key)
+Snake::StepFunction Snake::selectStep(const RuleParams& rules)
 {
-    if (this->checkCollision() || this->mSnake.size()==0 || this->touchObstacle(key)==2)
-        return true;
-    return false;
+    if (rules.walls == WallRule::Wrap)
+    {
+        return selectObstacles<WrapWalls>(rules);
+    }
+    return selectObstacles<SolidWalls>(rules);
 }
 
 int Snake::getLength()
@@ -2,6 +2,12 @@
 #define SNAKE_H
 
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "rules.h"
+
+class Map;
 
 enum class Direction
 {
@@ -11,6 +17,8 @@ enum class Direction
     Right = 3,
 };
 
+// A cell packed into one word, x in the low and y in the high 32 bits,
+// so cells compare in one instruction and worlds keep their full width
 class SnakeBody
 {
 public:
@@ -18,10 +26,64 @@ public:
     SnakeBody(int x, int y);
     int getX() const;
     int getY() const;
-    bool operator == (const SnakeBody& snakeBody);
+    uint64_t getPacked() const;
+    static SnakeBody fromPacked(uint64_t cell);
+    bool operator == (const SnakeBody& snakeBody) const;
+    bool operator != (const SnakeBody& snakeBody) const;
+private:
+    uint64_t mCell;
+};
+
+// The body as a ring, the head is added and the tail dropped without
+// shifting the segments in between. Index 0 is the head.
+class BodyRing
+{
+public:
+    BodyRing();
+    // Rounded up to a power of two
+    void reserve(int capacity);
+    void clear();
+    void pushFront(const SnakeBody& cell);
+    void popBack();
+    const SnakeBody& operator [] (int index) const;
+    // Index of the cell in the body, -1 if it is not part of it
+    int find(const SnakeBody& cell) const;
+    int size() const;
+    bool empty() const;
+    // Bytes held by the ring, grown only past the reserve
+    std::size_t getMemoryUsage() const;
+
 private:
-    int mX;
-    int mY;
+    std::vector<SnakeBody> mCells;
+    int mMask;
+    int mHead;
+    int mSize;
+};
+
+// What the cell ahead of the head held, decided once per move
+enum class StepResult
+{
+    Moved,
+    Ate,
+    // Rammed an obstacle holding the survive key, costs a segment
+    ObstacleSurvived,
+    ObstacleFatal,
+    HitWall,
+    HitSelf,
+};
+
+struct SnakeStep
+{
+    StepResult result;
+    // The cell the head entered, or would have on a fatal move
+    SnakeBody head;
+    // The cell the head enters next if the direction stays
+    SnakeBody ahead;
+    // Tail cells the move left, the most recent tail first, then any a
+    // shrink power-up took
+    static const int kMaxFreed = 4;
+    SnakeBody freed[kMaxFreed];
+    int freedNum;
 };
 
 // Snake class should have no depency on the GUI library
@@ -30,41 +92,67 @@ class Snake
 public:
     //Snake();
     Snake(int gameBoardWidth, int gameBoardHeight, int initialSnakeLength);
+    // Adopt new board bounds after a terminal resize, keeping the body
+    void resizeBoard(int gameBoardWidth, int gameBoardHeight);
     // Set random seed
     void setRandomSeed();
-    // Initialize snake
+    // Initialize snake, marking it on a map whose snake layer was cleared
     void initializeSnake();
+    // Where the head is placed by initializeSnake, the board center by default
+    void setSpawnPoint(int x, int y);
     // Checking API for generating random food
     bool isPartOfSnake(int x, int y);
     void senseFood(SnakeBody food);
-    bool touchFood();
 
-    void senseObstacle(SnakeBody obstacle);
-    int touchObstacle(int key);
-    bool obstacleSurviveCheck(int key);
-    // Check if the snake is dead
-    bool hitWall();
-    bool hitSelf();
-    bool checkCollision();
-    bool checkDeath(int key);
+    // The snake reads obstacles straight from the map instead of copying
+    // them, and marks its own cells in the map's snake layer
+    void senseMap(Map* map);
+    static bool isDeath(StepResult result);
+
+    // Gives up to segments tail cells, keeping two, and adds them to the step
+    void shrink(int segments, SnakeStep& step);
+    // Obstacles are passed through while ghosting
+    void setGhost(bool ghost);
+    bool isGhost() const;
+    int getPendingGrowth() const;
+    // Puts back a saved body, head first, on a map whose snake layer was cleared
+    void restore(const uint64_t* cells, int length, Direction direction, int pendingGrowth, bool ghost);
 
     bool changeDirection(Direction newDirection);
-    std::vector<SnakeBody>& getSnake();
+    Direction getDirection() const;
+    const BodyRing& getSnake() const;
     int getLength();
-    SnakeBody createNewHead();
     SnakeBody newHead();
-    int moveFoward(int key);
+    // Moves one cell under a rule set, the next head is computed and
+    // classified once
+    template <class Rules>
+    SnakeStep step(int key);
+    // The step instantiated for the rules
+    typedef SnakeStep (Snake::*StepFunction)(int key);
+    static StepFunction selectStep(const RuleParams& rules);
 
 private:
-    const int mGameBoardWidth;
-    const int mGameBoardHeight;
+    void markCell(const SnakeBody& cell, bool set);
+    template <class Walls, class Obstacles>
+    static StepFunction selectGrowth(int growth);
+    template <class Walls>
+    static StepFunction selectObstacles(const RuleParams& rules);
+
+    int mGameBoardWidth;
+    int mGameBoardHeight;
     // Snake information
     const int mInitialSnakeLength;
+    // Longer snakes grow the body past this reserve on demand
+    const int mMaxReservedLength = 1 << 16;
+    int mSpawnX;
+    int mSpawnY;
     Direction mDirection;
     SnakeBody mFood;
-    std::vector<SnakeBody> mObstacle;
-    std::vector<SnakeBody> mPowerPath;
-    std::vector<SnakeBody> mSnake;
+    Map* mMap;
+    BodyRing mSnake;
+    // Segments still to add from food eaten under a growth above one
+    int mPendingGrowth;
+    bool mGhost;
 };
 
 #endif
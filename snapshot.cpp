@@ -0,0 +1,181 @@
+#include <cstdio>
+#include <cstring>
+
+// For memory mapping and the file replacement
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "checksum.h"
+
+static const char gSnapshotMagic[8] = {'S', 'N', 'K', 'S', 'N', 'A', 'P', '1'};
+static const uint32_t gSnapshotVersion = 3;
+
+static uint64_t alignTo8(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// The header's checksum field is taken as zero
+static uint32_t checksumSnapshot(const unsigned char* data, std::size_t size)
+{
+    const uint32_t zero = 0;
+    std::size_t field = offsetof(SnapshotHeader, checksum);
+    uint32_t crc = crc32(data, field);
+    crc = crc32(&zero, sizeof(zero), crc);
+    return crc32(data + field + sizeof(zero), size - field - sizeof(zero), crc);
+}
+
+// True when count items of itemSize at offset lie inside size bytes
+static bool fits(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t size)
+{
+    return offset % 8 == 0 && offset <= size && count <= (size - offset) / itemSize;
+}
+
+SnapshotFile::SnapshotFile(): mData(nullptr), mSize(0)
+{
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    this->close();
+}
+
+bool SnapshotFile::open(const std::string& path)
+{
+    this->close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    this->mData = static_cast<const unsigned char*>(data);
+    this->mSize = info.st_size;
+
+    const SnapshotHeader& header = this->getHeader();
+    if (std::memcmp(header.magic, gSnapshotMagic, sizeof(gSnapshotMagic)) != 0
+        || header.version != gSnapshotVersion || header.size != this->mSize
+        || !fits(header.randomOffset, kRandomWords, sizeof(uint32_t), this->mSize)
+        || !fits(header.bodyOffset, header.bodyLength, sizeof(uint64_t), this->mSize)
+        || !fits(header.powerPathOffset, header.powerPathLength, sizeof(uint64_t), this->mSize)
+        || !fits(header.moverOffset, header.moverNum, sizeof(SnapshotMover), this->mSize)
+        || !fits(header.obstacleOffset, header.obstacleWords, sizeof(uint64_t), this->mSize)
+        || header.checksum != checksumSnapshot(this->mData, this->mSize))
+    {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotFile::close()
+{
+    if (this->mData != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(this->mData), this->mSize);
+    }
+    this->mData = nullptr;
+    this->mSize = 0;
+}
+
+bool SnapshotFile::isOpen() const
+{
+    return this->mData != nullptr;
+}
+
+const SnapshotHeader& SnapshotFile::getHeader() const
+{
+    return *reinterpret_cast<const SnapshotHeader*>(this->mData);
+}
+
+const uint32_t* SnapshotFile::getRandomState() const
+{
+    return reinterpret_cast<const uint32_t*>(this->mData + this->getHeader().randomOffset);
+}
+
+const uint64_t* SnapshotFile::getBody() const
+{
+    return reinterpret_cast<const uint64_t*>(this->mData + this->getHeader().bodyOffset);
+}
+
+const uint64_t* SnapshotFile::getPowerPath() const
+{
+    return reinterpret_cast<const uint64_t*>(this->mData + this->getHeader().powerPathOffset);
+}
+
+const SnapshotMover* SnapshotFile::getMovers() const
+{
+    return reinterpret_cast<const SnapshotMover*>(this->mData + this->getHeader().moverOffset);
+}
+
+const uint64_t* SnapshotFile::getObstacleBits() const
+{
+    return reinterpret_cast<const uint64_t*>(this->mData + this->getHeader().obstacleOffset);
+}
+
+void SnapshotFile::layout(std::vector<unsigned char>& buffer, uint32_t bodyLength, uint32_t powerPathLength,
+    uint32_t moverNum, uint64_t obstacleWords)
+{
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, gSnapshotMagic, sizeof(gSnapshotMagic));
+    header.version = gSnapshotVersion;
+    header.bodyLength = bodyLength;
+    header.powerPathLength = powerPathLength;
+    header.moverNum = moverNum;
+    header.obstacleWords = obstacleWords;
+    header.randomOffset = alignTo8(sizeof(SnapshotHeader));
+    header.bodyOffset = alignTo8(header.randomOffset + kRandomWords * sizeof(uint32_t));
+    header.powerPathOffset = alignTo8(header.bodyOffset + uint64_t(bodyLength) * sizeof(uint64_t));
+    header.moverOffset = alignTo8(header.powerPathOffset + uint64_t(powerPathLength) * sizeof(uint64_t));
+    header.obstacleOffset = alignTo8(header.moverOffset + uint64_t(moverNum) * sizeof(SnapshotMover));
+    header.size = header.obstacleOffset + obstacleWords * sizeof(uint64_t);
+    // resize() keeps the capacity, a game saving again reuses it
+    buffer.resize(header.size);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+}
+
+bool SnapshotFile::write(const std::string& path, std::vector<unsigned char>& buffer)
+{
+    SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(buffer.data());
+    header->checksum = checksumSnapshot(buffer.data(), buffer.size());
+    // Written aside and renamed over, a crash mid-save leaves the last
+    // snapshot in place. Not synced: a save has to stay well under a
+    // millisecond, and a clean shutdown flushes it anyway.
+    std::string temporaryPath = path + ".tmp";
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    const unsigned char* bytes = buffer.data();
+    std::size_t size = buffer.size();
+    bool ok = true;
+    while (ok && size > 0)
+    {
+        ssize_t written = ::write(fd, bytes, size);
+        ok = written > 0;
+        bytes += ok ? written : 0;
+        size -= ok ? written : 0;
+    }
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
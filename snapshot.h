@@ -0,0 +1,134 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * A game suspended mid-round, written by Engine::saveSnapshot and mapped
+ * read-only by SnapshotFile.
+ *
+ * Layout, every section 8-byte aligned:
+ *   SnapshotHeader
+ *   random state     kRandomWords uint32 words, the engine's mt19937 as
+ *                    its textual form: 624 state words and the position
+ *   body             bodyLength packed uint64 cells, the head first
+ *   power path       powerPathLength packed uint64 cells
+ *   movers           moverNum SnapshotMover
+ *   obstacle layer   obstacleWords uint64 words, only for generated boards
+ *
+ * Generated boards keep their obstacle layer, as the terminal they were
+ * generated for may have been resized since. Worlds and levels are fixed
+ * by their seed or their pack and only the movers are stored, so a huge
+ * board costs no more to save than a small one.
+ */
+
+enum class SnapshotBoard : uint32_t
+{
+    Generated,
+    Level,
+    World,
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    // CRC-32 of the whole file with this field zeroed
+    uint32_t checksum;
+    uint64_t size;
+
+    SnapshotBoard board;
+    uint32_t width;
+    uint32_t height;
+    uint32_t seed;
+    // The level a Level board was saved on and the CRC-32 of its pack,
+    // a snapshot only resumes on the same level of the same pack
+    int32_t levelIndex;
+    uint32_t levelChecksum;
+
+    // RuleParams
+    uint32_t walls;
+    uint32_t obstacles;
+    int32_t growth;
+    uint32_t speed;
+    int32_t powerUpInterval;
+    int32_t powerUpLifetime;
+    int32_t effectDuration;
+
+    uint32_t direction;
+    // The direction the last DirectionChanged event reported
+    uint32_t lastDirection;
+    int32_t pendingGrowth;
+    uint32_t ghost;
+    uint32_t powerUp;
+    uint64_t food;
+    uint64_t snakeAhead;
+    uint64_t powerUpCell;
+    int64_t tickCount;
+    int32_t points;
+    // The pacing of the game that saved it
+    int32_t difficulty;
+    int32_t delay;
+    // Ticks left on the engine's timers, 0 for one that is not running
+    int32_t spawnTimer;
+    int32_t powerUpTimer;
+    int32_t effectTimers[8];
+
+    uint32_t bodyLength;
+    uint32_t powerPathLength;
+    uint32_t moverNum;
+    uint64_t obstacleWords;
+    // Offsets of the sections from the start of the file
+    uint64_t randomOffset;
+    uint64_t bodyOffset;
+    uint64_t powerPathOffset;
+    uint64_t moverOffset;
+    uint64_t obstacleOffset;
+};
+
+struct SnapshotMover
+{
+    int32_t x;
+    int32_t y;
+    int32_t direction;
+    int32_t step;
+    int32_t length;
+    int32_t loop;
+};
+
+class SnapshotFile
+{
+public:
+    static const int kRandomWords = 625;
+
+    SnapshotFile();
+    ~SnapshotFile();
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator = (const SnapshotFile&) = delete;
+
+    // False unless the file is complete, of this version and intact
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    const SnapshotHeader& getHeader() const;
+    const uint32_t* getRandomState() const;
+    const uint64_t* getBody() const;
+    const uint64_t* getPowerPath() const;
+    const SnapshotMover* getMovers() const;
+    const uint64_t* getObstacleBits() const;
+
+    // Lays out the sections after the header in buffer, resized to fit
+    static void layout(std::vector<unsigned char>& buffer, uint32_t bodyLength, uint32_t powerPathLength,
+        uint32_t moverNum, uint64_t obstacleWords);
+    // Seals a laid out and filled buffer and replaces the file with it
+    static bool write(const std::string& path, std::vector<unsigned char>& buffer);
+
+private:
+    const unsigned char* mData;
+    std::size_t mSize;
+};
+
+#endif
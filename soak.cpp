@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// For the heap statistics and the page size
+#include <malloc.h>
+#include <unistd.h>
+
+#include "soak.h"
+#include "controller.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// The resident set from /proc, 0 where there is none
+static std::size_t getResidentBytes()
+{
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+    {
+        return 0;
+    }
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    int read = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    return read == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+// Bytes handed out by malloc and not freed, mapped chunks included
+static std::size_t getHeapBytes()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Nearest rank, the values are sorted
+static double percentile(const std::vector<double>& values, double share)
+{
+    std::size_t rank = std::max<std::size_t>(1, share * values.size() + 0.5);
+    return values[std::min(rank, values.size()) - 1];
+}
+
+SoakTest::SoakTest(const SoakParams& params)
+    : mParams(params), mEngine(params.boardWidth, params.boardHeight, params.mapParams, 2), mKeepStride(1), mSampleNum(0)
+{
+    this->mEngine.setRules(this->mParams.rules);
+    this->mEngine.setSpaceTracking(true);
+    this->mTickTimes.reserve(this->mParams.sampleTicks);
+    this->mSamples.reserve(kKeptSampleNum);
+}
+
+const SoakSample& SoakTest::sample(double seconds, long long ticks, int rounds)
+{
+    SoakSample sample;
+    sample.seconds = seconds;
+    sample.ticks = ticks;
+    sample.rounds = rounds;
+    sample.residentBytes = getResidentBytes();
+    sample.heapBytes = getHeapBytes();
+    sample.bodyBytes = this->mEngine.getSnake().getSnake().getMemoryUsage();
+    sample.mapBytes = this->mEngine.getMap().getMemoryUsage();
+    sample.powerPathCapacity = this->mEngine.getMap().getPowerPath().capacity();
+    std::sort(this->mTickTimes.begin(), this->mTickTimes.end());
+    sample.tickP50 = percentile(this->mTickTimes, 0.5);
+    sample.tickP99 = percentile(this->mTickTimes, 0.99);
+    sample.tickMax = this->mTickTimes.back();
+    this->mTickTimes.clear();
+    this->mLastSample = sample;
+    // The first row always stays, it is the warm-up the check skips
+    if (this->mSampleNum ++ % this->mKeepStride != 0)
+    {
+        return this->mLastSample;
+    }
+    if (this->mSamples.size() == kKeptSampleNum)
+    {
+        for (int i = 0; i < kKeptSampleNum / 2; i ++)
+        {
+            this->mSamples[i] = this->mSamples[i * 2];
+        }
+        this->mSamples.resize(kKeptSampleNum / 2);
+        this->mKeepStride *= 2;
+    }
+    this->mSamples.push_back(sample);
+    return this->mLastSample;
+}
+
+// The middle value of one member over the rows [first, last)
+static double median(const std::vector<SoakSample>& samples, int first, int last, double SoakSample::* member)
+{
+    std::vector<double> values;
+    for (int i = first; i < last; i ++)
+    {
+        values.push_back(samples[i].*member);
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+bool SoakTest::checkTrends() const
+{
+    // The first row warms the caches and the allocator up
+    int rows = this->mSamples.size() - 1;
+    if (rows < 6)
+    {
+        // A leak that went unmeasured is no pass
+        std::cout << "Too few rows to tell a trend, " << rows << " after the first where 6 are needed,"
+            << " run longer or sample more often" << std::endl;
+        return false;
+    }
+    int third = rows / 3;
+    int earlyBegin = 1;
+    int lateBegin = this->mSamples.size() - third;
+    // A leak never gives back, so even the smallest late reading is above
+    // the largest early one
+    const char* names[] = {"resident memory", "heap", "snake body", "map"};
+    std::size_t SoakSample::* members[] = {&SoakSample::residentBytes, &SoakSample::heapBytes,
+        &SoakSample::bodyBytes, &SoakSample::mapBytes};
+    bool ok = true;
+    for (int i = 0; i < 4; i ++)
+    {
+        std::size_t early = 0;
+        std::size_t late = SIZE_MAX;
+        for (int j = earlyBegin; j < earlyBegin + third; j ++)
+        {
+            early = std::max(early, this->mSamples[j].*members[i]);
+        }
+        for (int j = lateBegin; j < this->mSamples.size(); j ++)
+        {
+            late = std::min(late, this->mSamples[j].*members[i]);
+        }
+        if (late > early + this->mParams.memoryTolerance)
+        {
+            std::cout << names[i] << " grew from " << early << " to " << late << " bytes" << std::endl;
+            ok = false;
+        }
+    }
+    double earlyCapacity = 0;
+    for (int j = earlyBegin; j < earlyBegin + third; j ++)
+    {
+        earlyCapacity = std::max<double>(earlyCapacity, this->mSamples[j].powerPathCapacity);
+    }
+    double lateCapacity = this->mLastSample.powerPathCapacity;
+    if (lateCapacity > earlyCapacity * 2 && lateCapacity > this->mParams.mapParams.powerPathLength * 2)
+    {
+        std::cout << "power path capacity grew from " << earlyCapacity << " to " << lateCapacity << std::endl;
+        ok = false;
+    }
+    // Tick times are noisy, the medians of the thirds are compared, with
+    // a microsecond of slack for timer resolution
+    double early = median(this->mSamples, earlyBegin, earlyBegin + third, &SoakSample::tickP99);
+    double late = median(this->mSamples, lateBegin, this->mSamples.size(), &SoakSample::tickP99);
+    if (late > early * (1 + this->mParams.latencyTolerance) + 1)
+    {
+        std::cout << "p99 tick time grew from " << early << " to " << late << " us" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+bool SoakTest::run(const std::string& reportPath)
+{
+    std::fstream report(reportPath, report.out | report.trunc);
+    if (!report.is_open())
+    {
+        std::cerr << "Failed to open " << reportPath << std::endl;
+        return false;
+    }
+    report << "seconds,ticks,rounds,resident_bytes,heap_bytes,body_bytes,map_bytes,power_path_capacity,"
+        << "tick_p50_us,tick_p99_us,tick_max_us,seed" << std::endl;
+    // Round i is played from seed + i, the seed replays the whole run
+    std::cout << "Soak seed " << this->mParams.seed << std::endl;
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::ratio<60> >(this->mParams.minutes));
+    long long ticks = 0;
+    int rounds = 0;
+    bool playing = false;
+    long long lastMeal = 0;
+    int points = 0;
+    while (true)
+    {
+        if (!playing)
+        {
+            this->mEngine.initializeRound(this->mParams.seed + rounds);
+            this->mEngine.spawnItems();
+            rounds ++;
+            playing = true;
+            lastMeal = 0;
+            points = 0;
+        }
+        this->mEngine.getSnake().changeDirection(GreedyController::chooseDirection(this->mEngine));
+        Clock::time_point before = Clock::now();
+        // No key held, so obstacles are never survived
+        this->mEngine.step(0);
+        Clock::time_point after = Clock::now();
+        this->mTickTimes.push_back(std::chrono::duration<double, std::micro>(after - before).count());
+        ticks ++;
+        if (this->mEngine.getPoints() != points)
+        {
+            points = this->mEngine.getPoints();
+            lastMeal = this->mEngine.getTickCount();
+        }
+        playing = !this->mEngine.isDead() && this->mEngine.getTickCount() - lastMeal < this->mParams.starvationTicks;
+
+        if (this->mTickTimes.size() < this->mParams.sampleTicks)
+        {
+            continue;
+        }
+        double seconds = std::chrono::duration<double>(after - start).count();
+        const SoakSample& sample = this->sample(seconds, ticks, rounds);
+        // Flushed row by row, a long run can be watched while it goes
+        report << sample.seconds << "," << sample.ticks << "," << sample.rounds << "," << sample.residentBytes << ","
+            << sample.heapBytes << "," << sample.bodyBytes << "," << sample.mapBytes << "," << sample.powerPathCapacity << ","
+            << sample.tickP50 << "," << sample.tickP99 << "," << sample.tickMax << "," << this->mParams.seed << std::endl;
+        if (!report)
+        {
+            std::cerr << "Failed to write " << reportPath << std::endl;
+            return false;
+        }
+        if (after >= end)
+        {
+            break;
+        }
+    }
+    std::cout << ticks << " ticks in " << rounds << " rounds, seed " << this->mParams.seed << std::endl;
+    bool ok = this->checkTrends();
+    std::cout << (ok ? "No upward trend" : "Soak failed") << std::endl;
+    return ok;
+}
@@ -0,0 +1,78 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <string>
+#include <vector>
+
+#include "map.h"
+#include "engine.h"
+
+struct SoakParams
+{
+    // How long rounds are played back to back
+    double minutes = 60;
+    // Ticks between two rows of the report
+    int sampleTicks = 1000000;
+    // A round is dropped once the snake goes this long without food
+    int starvationTicks = 2000;
+    unsigned int seed = 1;
+    int boardWidth = 80;
+    int boardHeight = 30;
+    MapGenParams mapParams;
+    RuleParams rules;
+    // The run fails when memory or the p99 tick time of the last third of
+    // the rows is this much above the first third
+    std::size_t memoryTolerance = 1 << 20;
+    double latencyTolerance = 0.5;
+};
+
+// What the process and the engine hold, and how long its ticks took,
+// over one stretch of ticks
+struct SoakSample
+{
+    double seconds;
+    long long ticks;
+    int rounds;
+    std::size_t residentBytes;
+    std::size_t heapBytes;
+    std::size_t bodyBytes;
+    std::size_t mapBytes;
+    std::size_t powerPathCapacity;
+    // Microseconds
+    double tickP50;
+    double tickP99;
+    double tickMax;
+};
+
+// Plays headless rounds under a greedy autopilot for hours, to catch
+// per-tick work that grows: memory that is never given back, or ticks
+// that slow down as the session goes on.
+class SoakTest
+{
+public:
+    explicit SoakTest(const SoakParams& params);
+    // Writes a CSV row every sampleTicks, false when the file could not
+    // be written, too few rows were written to judge, or memory or tick
+    // time trended upward
+    bool run(const std::string& reportPath);
+
+private:
+    const SoakSample& sample(double seconds, long long ticks, int rounds);
+    bool checkTrends() const;
+
+    SoakParams mParams;
+    Engine mEngine;
+    // Tick times of the current stretch, reused
+    std::vector<double> mTickTimes;
+    // Rows kept for the trend check. Held to a fixed capacity, thinned
+    // to every other row whenever it fills, so the test's own memory
+    // stays flat however long it runs.
+    static const int kKeptSampleNum = 1024;
+    std::vector<SoakSample> mSamples;
+    // Only every mKeepStride-th row is added after a thinning
+    int mKeepStride;
+    long long mSampleNum;
+    SoakSample mLastSample;
+};
+
+#endif
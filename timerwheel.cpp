@@ -0,0 +1,195 @@
+#include <algorithm>
+
+#include "timerwheel.h"
+
+static const int gOverflowList = TimerWheel::kLevelNum * TimerWheel::kSlotNum;
+static const int gIndexBits = 20;
+static const uint32_t gIndexMask = (1u << gIndexBits) - 1;
+
+TimerWheel::TimerWheel(): mTick(0), mTimerNum(0)
+{
+    std::fill(this->mHeads, this->mHeads + gOverflowList + 1, -1);
+}
+
+void TimerWheel::reset(long long tick)
+{
+    for (int i = 0; i < this->mNodes.size(); i ++)
+    {
+        if (this->mNodes[i].list >= 0)
+        {
+            this->mNodes[i].list = -1;
+            this->mNodes[i].generation ++;
+            this->mFreeNodes.push_back(i);
+        }
+    }
+    std::fill(this->mHeads, this->mHeads + gOverflowList + 1, -1);
+    this->mTick = tick;
+    this->mTimerNum = 0;
+}
+
+void TimerWheel::reserve(int timerNum)
+{
+    this->mNodes.reserve(timerNum);
+    this->mFreeNodes.reserve(timerNum);
+    this->mExpired.reserve(timerNum);
+}
+
+uint32_t TimerWheel::schedule(long long delay, int kind, int data)
+{
+    int index;
+    if (!this->mFreeNodes.empty())
+    {
+        index = this->mFreeNodes.back();
+        this->mFreeNodes.pop_back();
+    }
+    else
+    {
+        index = this->mNodes.size();
+        Node node = {};
+        node.generation = 1;
+        this->mNodes.push_back(node);
+    }
+    Node& node = this->mNodes[index];
+    node.deadline = this->mTick + std::max(1LL, delay);
+    node.kind = kind;
+    node.data = data;
+    this->link(index);
+    this->mTimerNum ++;
+    // The generation tells a recycled node from the timer it used to be
+    return ((node.generation & (0xffffffffu >> gIndexBits)) << gIndexBits) | uint32_t(index + 1);
+}
+
+bool TimerWheel::cancel(uint32_t handle)
+{
+    int index = this->findNode(handle);
+    if (index < 0)
+    {
+        return false;
+    }
+    this->unlink(index);
+    this->mNodes[index].generation ++;
+    this->mFreeNodes.push_back(index);
+    this->mTimerNum --;
+    return true;
+}
+
+long long TimerWheel::getDeadline(uint32_t handle) const
+{
+    int index = this->findNode(handle);
+    return index < 0 ? -1 : this->mNodes[index].deadline;
+}
+
+int TimerWheel::findNode(uint32_t handle) const
+{
+    int index = int(handle & gIndexMask) - 1;
+    if (index < 0 || index >= this->mNodes.size())
+    {
+        return -1;
+    }
+    const Node& node = this->mNodes[index];
+    if (node.list < 0 || (node.generation & (0xffffffffu >> gIndexBits)) != handle >> gIndexBits)
+    {
+        return -1;
+    }
+    return index;
+}
+
+const std::vector<TimerExpiry>& TimerWheel::advance()
+{
+    this->mExpired.clear();
+    this->mTick ++;
+    if ((this->mTick & (kSlotNum - 1)) == 0)
+    {
+        // Coarse levels first, what they hand down may land in a finer
+        // slot that cascades on this same tick
+        if ((this->mTick & ((1LL << (kSlotBits * kLevelNum)) - 1)) == 0)
+        {
+            this->cascade(gOverflowList);
+        }
+        for (int level = kLevelNum - 1; level >= 1; level --)
+        {
+            if ((this->mTick & ((1LL << (kSlotBits * level)) - 1)) == 0)
+            {
+                this->cascade(level * kSlotNum + ((this->mTick >> (kSlotBits * level)) & (kSlotNum - 1)));
+            }
+        }
+    }
+    int list = this->mTick & (kSlotNum - 1);
+    while (this->mHeads[list] >= 0)
+    {
+        int index = this->mHeads[list];
+        Node& node = this->mNodes[index];
+        TimerExpiry expiry = {node.kind, node.data};
+        this->mExpired.push_back(expiry);
+        this->unlink(index);
+        node.generation ++;
+        this->mFreeNodes.push_back(index);
+        this->mTimerNum --;
+    }
+    return this->mExpired;
+}
+
+long long TimerWheel::getTick() const
+{
+    return this->mTick;
+}
+
+int TimerWheel::getTimerNum() const
+{
+    return this->mTimerNum;
+}
+
+void TimerWheel::link(int index)
+{
+    Node& node = this->mNodes[index];
+    // The finest level where the deadline and now only differ inside the
+    // level's own slot bits
+    int list = gOverflowList;
+    for (int level = 0; level < kLevelNum; level ++)
+    {
+        int shift = kSlotBits * (level + 1);
+        if ((node.deadline >> shift) == (this->mTick >> shift))
+        {
+            list = level * kSlotNum + ((node.deadline >> (kSlotBits * level)) & (kSlotNum - 1));
+            break;
+        }
+    }
+    node.list = list;
+    node.prev = -1;
+    node.next = this->mHeads[list];
+    if (node.next >= 0)
+    {
+        this->mNodes[node.next].prev = index;
+    }
+    this->mHeads[list] = index;
+}
+
+void TimerWheel::unlink(int index)
+{
+    Node& node = this->mNodes[index];
+    if (node.prev >= 0)
+    {
+        this->mNodes[node.prev].next = node.next;
+    }
+    else
+    {
+        this->mHeads[node.list] = node.next;
+    }
+    if (node.next >= 0)
+    {
+        this->mNodes[node.next].prev = node.prev;
+    }
+    node.list = -1;
+}
+
+void TimerWheel::cascade(int list)
+{
+    int index = this->mHeads[list];
+    this->mHeads[list] = -1;
+    while (index >= 0)
+    {
+        int next = this->mNodes[index].next;
+        this->link(index);
+        index = next;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <cstdint>
+#include <vector>
+
+struct TimerExpiry
+{
+    int kind;
+    int data;
+};
+
+// Timers keyed by tick on a hierarchical wheel: four levels of 64 slots,
+// each level 64 times coarser than the one below. A timer sits in the
+// finest level whose span still holds its deadline and moves down a level
+// when its slot comes up, so a tick costs one slot of level 0 plus a
+// cascade every 64 ticks whatever the number of timers. Scheduling and
+// cancelling are O(1). Nodes are pooled, a steady game does not allocate.
+class TimerWheel
+{
+public:
+    static const int kSlotBits = 6;
+    static const int kSlotNum = 1 << kSlotBits;
+    static const int kLevelNum = 4;
+
+    TimerWheel();
+    // Drops every timer and restarts the clock at tick
+    void reset(long long tick);
+    // Room for timerNum pending timers, so scheduling up to that many never allocates
+    void reserve(int timerNum);
+    // Fires after delay ticks, at least one. The handle is never 0.
+    uint32_t schedule(long long delay, int kind, int data);
+    // False if the timer already fired or was cancelled
+    bool cancel(uint32_t handle);
+    // The tick the timer fires on, -1 once it fired or was cancelled
+    long long getDeadline(uint32_t handle) const;
+    // Moves on one tick, the timers due come back in the list
+    const std::vector<TimerExpiry>& advance();
+    long long getTick() const;
+    int getTimerNum() const;
+
+private:
+    struct Node
+    {
+        long long deadline;
+        int kind;
+        int data;
+        int prev;
+        int next;
+        // Slot list the node is linked into, -1 while it is free
+        int list;
+        uint32_t generation;
+    };
+
+    // The node of a pending timer, -1 for a stale handle
+    int findNode(uint32_t handle) const;
+    void link(int index);
+    void unlink(int index);
+    void cascade(int list);
+
+    std::vector<Node> mNodes;
+    std::vector<int> mFreeNodes;
+    // One list per slot of every level, then the timers beyond the top level
+    int mHeads[kLevelNum * kSlotNum + 1];
+    std::vector<TimerExpiry> mExpired;
+    long long mTick;
+    int mTimerNum;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "trainer.h"
+
+Trainer::Trainer(const TrainerParams& params)
+    : mParams(params), mBestFitness(-1), mRandom(params.seed)
+{
+    if (this->mParams.threadNum <= 0)
+    {
+        this->mParams.threadNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    this->mParams.threadNum = std::min(this->mParams.threadNum, this->mParams.populationSize);
+    // Built here rather than in the workers, a Snake reseeds rand() when created
+    for (int i = 0; i < this->mParams.threadNum; i ++)
+    {
+        this->mEngines.emplace_back(new Engine(this->mParams.boardWidth, this->mParams.boardHeight, this->mParams.mapParams, 2));
+        this->mEngines.back()->setRules(this->mParams.rules);
+    }
+    std::normal_distribution<float> initial(0.0f, 0.5f);
+    this->mPopulation.resize(this->mParams.populationSize);
+    for (int i = 0; i < this->mPopulation.size(); i ++)
+    {
+        std::vector<float>& weights = this->mPopulation[i].getWeights();
+        for (int j = 0; j < weights.size(); j ++)
+        {
+            weights[j] = initial(this->mRandom);
+        }
+    }
+    this->mOffspring.resize(this->mParams.populationSize);
+    this->mFitness.resize(this->mParams.populationSize);
+    this->mRanking.resize(this->mParams.populationSize);
+}
+
+double Trainer::evaluate(Engine& engine, const NeuralController& controller, unsigned int generationSeed) const
+{
+    double fitness = 0;
+    for (int round = 0; round < this->mParams.roundsPerGenome; round ++)
+    {
+        engine.initializeRound(generationSeed + round);
+        engine.spawnItems();
+        long long lastMeal = 0;
+        int points = 0;
+        while (!engine.isDead() && engine.getTickCount() < this->mParams.maxTicks
+            && engine.getTickCount() - lastMeal < this->mParams.starvationTicks)
+        {
+            engine.getSnake().changeDirection(controller.chooseDirection(engine));
+            // No key held, so obstacles are never survived
+            engine.step(0);
+            if (engine.getPoints() != points)
+            {
+                points = engine.getPoints();
+                lastMeal = engine.getTickCount();
+            }
+        }
+        // Food dominates, survival breaks ties between genomes that never eat
+        fitness += engine.getPoints() * 1000.0 + std::min<long long>(engine.getTickCount(), this->mParams.starvationTicks);
+    }
+    return fitness / this->mParams.roundsPerGenome;
+}
+
+void Trainer::evaluatePopulation(unsigned int generationSeed)
+{
+    // Workers pull genomes off a shared counter, so a slow one never holds up the rest
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < this->mParams.threadNum; i ++)
+    {
+        workers.emplace_back([this, i, generationSeed, &next]()
+        {
+            Engine& engine = *this->mEngines[i];
+            for (int index = next ++; index < this->mPopulation.size(); index = next ++)
+            {
+                this->mFitness[index] = this->evaluate(engine, this->mPopulation[index], generationSeed);
+            }
+        });
+    }
+    for (int i = 0; i < workers.size(); i ++)
+    {
+        workers[i].join();
+    }
+}
+
+int Trainer::selectParent()
+{
+    // The fittest of a few random picks
+    int best = this->mRandom() % this->mPopulation.size();
+    for (int i = 1; i < this->mParams.tournamentSize; i ++)
+    {
+        int candidate = this->mRandom() % this->mPopulation.size();
+        if (this->mFitness[candidate] > this->mFitness[best])
+        {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+void Trainer::breed()
+{
+    for (int i = 0; i < this->mRanking.size(); i ++)
+    {
+        this->mRanking[i] = i;
+    }
+    std::sort(this->mRanking.begin(), this->mRanking.end(),
+        [this](int a, int b) { return this->mFitness[a] > this->mFitness[b]; });
+
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, this->mParams.mutationScale);
+    for (int i = 0; i < this->mOffspring.size(); i ++)
+    {
+        std::vector<float>& child = this->mOffspring[i].getWeights();
+        if (i < this->mParams.eliteNum)
+        {
+            child = this->mPopulation[this->mRanking[i]].getWeights();
+            continue;
+        }
+        // Uniform crossover, then gaussian mutation of a share of the weights
+        const std::vector<float>& mother = this->mPopulation[this->selectParent()].getWeights();
+        const std::vector<float>& father = this->mPopulation[this->selectParent()].getWeights();
+        for (int j = 0; j < child.size(); j ++)
+        {
+            child[j] = (this->mRandom() & 1) ? mother[j] : father[j];
+            if (chance(this->mRandom) < this->mParams.mutationRate)
+            {
+                child[j] += noise(this->mRandom);
+            }
+        }
+    }
+    // The vectors trade places, no weights are reallocated
+    this->mPopulation.swap(this->mOffspring);
+}
+
+bool Trainer::run(int generations, const std::string& checkpointPath)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int generation = 0; generation < generations; generation ++)
+    {
+        unsigned int generationSeed = this->mRandom();
+        this->evaluatePopulation(generationSeed);
+
+        int best = std::max_element(this->mFitness.begin(), this->mFitness.end()) - this->mFitness.begin();
+        double mean = 0;
+        for (int i = 0; i < this->mFitness.size(); i ++)
+        {
+            mean += this->mFitness[i];
+        }
+        mean /= this->mFitness.size();
+        // Every generation plays new rounds, the checkpoint keeps the best seen so far
+        if (this->mFitness[best] > this->mBestFitness)
+        {
+            this->mBestFitness = this->mFitness[best];
+            this->mBest = this->mPopulation[best];
+            if (!this->mBest.save(checkpointPath))
+            {
+                std::cerr << "Failed to save " << checkpointPath << std::endl;
+                return false;
+            }
+        }
+
+        double minutes = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 60;
+        std::cout << "generation " << generation + 1 << " best " << this->mFitness[best] << " mean " << mean
+            << " food " << this->mFitness[best] / 1000 << " " << (generation + 1) / minutes << " generations/min" << std::endl;
+        this->breed();
+    }
+    return true;
+}
+
+const NeuralController& Trainer::getBest() const
+{
+    return this->mBest;
+}
@@ -0,0 +1,61 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "map.h"
+#include "engine.h"
+#include "controller.h"
+
+struct TrainerParams
+{
+    int populationSize = 256;
+    // Every genome of a generation plays the same seeded rounds
+    int roundsPerGenome = 4;
+    int maxTicks = 3000;
+    // A round also ends once the snake goes this long without food
+    int starvationTicks = 300;
+    // The best genomes go to the next generation unchanged
+    int eliteNum = 8;
+    int tournamentSize = 4;
+    float mutationRate = 0.1f;
+    float mutationScale = 0.3f;
+    // 0 uses every core
+    int threadNum = 0;
+    unsigned int seed = 1;
+    int boardWidth = 60;
+    int boardHeight = 30;
+    MapGenParams mapParams;
+    RuleParams rules;
+};
+
+// Evolves NeuralController weights on headless engines, one per thread
+class Trainer
+{
+public:
+    explicit Trainer(const TrainerParams& params);
+    // Runs the generations, saving the best genome after each one
+    bool run(int generations, const std::string& checkpointPath);
+    const NeuralController& getBest() const;
+
+private:
+    double evaluate(Engine& engine, const NeuralController& controller, unsigned int generationSeed) const;
+    void evaluatePopulation(unsigned int generationSeed);
+    int selectParent();
+    void breed();
+
+    TrainerParams mParams;
+    std::vector<std::unique_ptr<Engine> > mEngines;
+    std::vector<NeuralController> mPopulation;
+    std::vector<NeuralController> mOffspring;
+    std::vector<double> mFitness;
+    std::vector<int> mRanking;
+    NeuralController mBest;
+    double mBestFitness;
+    std::mt19937 mRandom;
+};
+
+#endif